@@ -0,0 +1,220 @@
+/*///////////////////////////////////////
+// bench.h: This file contains a minimal
+// microbenchmark harness for the host
+// benchmarks, each benchmark is run in
+// repeated batches after a warm-up batch and
+// the median and fastest batch are reported
+// as "key value" lines and as a JSON file
+// that can be compared between commits
+//
+// CPU cycles per operation are counted with
+// perf_event_open where the kernel allows it
+//
+// Including this file replaces the global
+// operator new so benchmarks can count heap
+// allocations of every thread
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace Bench{
+
+	const int DEFAULT_REPEATS = 7;		// Timed batches per benchmark, the median batch is reported
+
+	// doNotOptimize: stops the compiler from removing computation of value
+	template<typename Type>
+	void doNotOptimize(const Type& value){
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	// allocationCount: operator new calls of all threads since the program started
+	std::atomic<uint64_t>& allocationCount(){
+		static std::atomic<uint64_t> count(0);
+		return count;
+	}
+
+	// allocate: counted malloc behind the replaced operator new
+	void* allocate(size_t size){
+		allocationCount().fetch_add(1, std::memory_order_relaxed);
+		void* memory = malloc(size == 0 ? 1 : size);
+		if(memory == NULL){
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	// nowNanos: monotonic clock in nanoseconds
+	int64_t nowNanos(){
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// class CycleCounter: user space CPU cycles of the calling thread, unavailable if perf events are not permitted
+	class CycleCounter{
+	public:
+		CycleCounter(){
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			mFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+		~CycleCounter(){
+			if(mFd >= 0){
+				close(mFd);
+			}
+		}
+		bool available() const{
+			return mFd >= 0;
+		}
+		// read: cycles counted so far, 0 if unavailable
+		uint64_t read() const{
+			uint64_t cycles = 0;
+			if(mFd < 0 || ::read(mFd, &cycles, sizeof(cycles)) != sizeof(cycles)){
+				return 0;
+			}
+			return cycles;
+		}
+
+	private:
+		int mFd;	// perf event file descriptor, -1 if unavailable
+	};
+
+	CycleCounter& cycleCounter(){
+		static CycleCounter counter;
+		return counter;
+	}
+
+	// Result: one benchmark, value is in unit (ns/op for microbenchmarks)
+	struct Result{
+		std::string name;
+		long iterations;		// Operations per batch
+		double median;			// Median batch
+		double best;			// Best batch, lowest ns/op or highest rate
+		std::string unit;
+		double cycles;			// CPU cycles per operation of the median batch, negative if not counted
+	};
+
+	// class Suite: runs benchmarks matching a filter and collects their results
+	class Suite{
+	public:
+		Suite(const std::string& filter, int repeats){
+			mFilter = filter;
+			mRepeats = repeats;
+		}
+
+		// selected: returns true if benchmark name matches the filter
+		bool selected(const std::string& name) const{
+			return mFilter.empty() || name.find(mFilter) != std::string::npos;
+		}
+
+		// run: times iterations calls of function per batch and records ns/op
+		template<typename Function>
+		void run(const std::string& name, long iterations, Function function){
+			if(!selected(name)){
+				return;
+			}
+			for(long i = 0; i < iterations; i++){
+				function();
+			}
+			std::vector<std::pair<double, double> > batches;
+			for(int r = 0; r < mRepeats; r++){
+				uint64_t cycles = cycleCounter().read();
+				int64_t start = nowNanos();
+				for(long i = 0; i < iterations; i++){
+					function();
+				}
+				int64_t elapsed = nowNanos() - start;
+				cycles = cycleCounter().read() - cycles;
+				batches.push_back(std::make_pair((double)elapsed/iterations, (double)cycles/iterations));
+			}
+			std::sort(batches.begin(), batches.end());
+			const std::pair<double, double>& median = batches[batches.size()/2];
+			add(name, iterations, median.first, batches[0].first, "ns/op", cycleCounter().available() ? median.second : -1.0);
+		}
+
+		// add: records a result measured by the caller
+		void add(const std::string& name, long iterations, double median, double best, const std::string& unit, double cycles = -1.0){
+			Result result = {name, iterations, median, best, unit, cycles};
+			mResults.push_back(result);
+			if(cycles >= 0){
+				printf("%s %.1f %s %.0f cycles\n", name.c_str(), median, unit.c_str(), cycles);
+			}
+			else{
+				printf("%s %.1f %s\n", name.c_str(), median, unit.c_str());
+			}
+			fflush(stdout);
+		}
+
+		// write: writes all results to path as JSON, one result per line so files diff cleanly, returns false on failure,
+		// build names the configuration measured (e.g. float or fixed-point arithmetic)
+		bool write(const std::string& path, const std::string& commit, const std::string& build) const{
+			FILE* file = fopen(path.c_str(), "w");
+			if(file == NULL){
+				return false;
+			}
+			fprintf(file, "{\"commit\":\"%s\",\"build\":\"%s\",\"repeats\":%d,\"results\":[\n", commit.c_str(), build.c_str(), mRepeats);
+			for(size_t i = 0; i < mResults.size(); i++){
+				const Result& result = mResults[i];
+				fprintf(file, "{\"name\":\"%s\",\"iterations\":%ld,\"median\":%.3f,\"best\":%.3f,\"unit\":\"%s\",\"cycles\":%.1f}%s\n", result.name.c_str(), result.iterations, result.median, result.best, result.unit.c_str(), result.cycles, i + 1 < mResults.size() ? "," : "");
+			}
+			fprintf(file, "]}\n");
+			return fclose(file) == 0;
+		}
+
+		int repeats() const{
+			return mRepeats;
+		}
+
+	private:
+		std::string mFilter;				// Substring a benchmark name must contain to run, empty runs all
+		int mRepeats;						// Timed batches per benchmark
+		std::vector<Result> mResults;		// Results in the order benchmarks ran
+	};
+}
+
+void* operator new(size_t size){
+	return Bench::allocate(size);
+}
+void* operator new[](size_t size){
+	return Bench::allocate(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+	Bench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+	return malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+	Bench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+	return malloc(size == 0 ? 1 : size);
+}
+void operator delete(void* memory) noexcept{
+	free(memory);
+}
+void operator delete[](void* memory) noexcept{
+	free(memory);
+}
+void operator delete(void* memory, size_t) noexcept{
+	free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept{
+	free(memory);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,895 @@
+/*///////////////////////////////////////
+// pongBench: host benchmarks and checks of
+// the game against the mock hardware, the
+// arithmetic is built twice with float and
+// fixed-point Real (see fixed.h), a failed
+// check exits non-zero
+//
+// Benchmarks and checks by name prefix:
+// image_ write_rect_  Image operators
+// frame_diff_ panel_  DrawContext frames
+// dirty_              dirty columns (check)
+// framebuffer_        shared frame ring (check)
+// stats_ paddle_ ultrasonic_ column_
+//                     filters, column table (check)
+// sensor_ jitter_     sensor reads
+// gpiomem_            mapped gpio (check)
+// startup_ step_      first frame, paddle response
+// alloc_              frame allocations (check)
+// game_ tables_       whole frames per second
+// sim_                virtual clock games (check)
+//
+// usage: pongBench [--output path] [--filter name] [--repeats n] [--commit id]
+*/
+
+#ifndef HOST_MOCK
+#error "pongBench runs against the mock hardware, build with make bench"
+#endif
+
+#include "motionPong.h"
+#include "scheduler.h"
+#include "bench/bench.h"
+
+// Pins of the sensor timed by the sensor benchmarks, away from the game's sensors
+const int BENCH_TRIGGER = 20;
+const int BENCH_ECHO = 21;
+// Distance simulated for the sensor benchmarks in metres
+const float BENCH_DISTANCE = 0.2f;
+// Hand positions the step response harness jumps between in metres
+const float STEP_NEAR = 0.1f;
+const float STEP_FAR = 0.35f;
+// Time a step may take to settle before it is abandoned
+const int64_t STEP_TIMEOUT_NANOS = 3000000000LL;
+// Simulated time each frame of the virtual clock soak takes, a 60Hz frame
+const int64_t SIM_FRAME_MICROS = 16667;
+// Whole cpu-vs-cpu games the virtual clock soak plays
+const int SIM_GAMES = 20;
+// Frames after which a simulated game counts as unfinished, over an hour of play
+const long SIM_MAX_FRAMES = 250000;
+// Echo times measured per run of the sensor jitter benchmark
+const int JITTER_READINGS = 300;
+// Busy threads per CPU loading the machine during the sensor jitter benchmark
+const int JITTER_LOAD_PER_CPU = 2;
+
+// percentile: p'th percentile of sorted values by nearest rank
+double percentile(const std::vector<double>& sorted, double p){
+	return sorted[(size_t)(p/100.0*(sorted.size() - 1) + 0.5)];
+}
+
+// writeScene: writes objects paddle sized rectangles into context, moving scenes shift them every frame
+void writeScene(OLED::DrawContext& context, int objects, bool moving, int frame){
+	int offset = moving ? frame%8 : 0;
+	for(int i = 0; i < objects; i++){
+		int x = (i%4)*30 + offset;
+		int y = (i/4)*14 + offset/2;
+		context.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, x, y);
+	}
+}
+
+// benchImage: Image operators and rasterising
+void benchImage(Bench::Suite& suite){
+	OLED::Image a;
+	OLED::Image b;
+	a.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, 10, 0);
+	b.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, 14, 0);
+	suite.run("image_xor", 20000, [&](){
+		OLED::Image c = a ^ b;
+		Bench::doNotOptimize(c);
+	});
+	suite.run("image_and", 20000, [&](){
+		OLED::Image c = a & b;
+		Bench::doNotOptimize(c);
+	});
+	suite.run("image_diff", 20000, [&](){
+		OLED::Image c = (a ^ b) & a;
+		Bench::doNotOptimize(c);
+	});
+	suite.run("image_assign", 20000, [&](){
+		b = a;
+		Bench::doNotOptimize(b);
+	});
+	suite.run("image_clear", 20000, [&](){
+		b.clear();
+		Bench::doNotOptimize(b);
+	});
+	int pixel = 0;
+	suite.run("image_write_pixel", 1000000, [&](){
+		a.writePixel(pixel%OLED::SCREEN_WIDTH, (pixel/OLED::SCREEN_WIDTH)%OLED::SCREEN_HEIGHT);
+		pixel++;
+	});
+	suite.run("write_rect_ball", 1000000, [&](){
+		a.writeRect(BALL_DIM.x, BALL_DIM.y, 60, 30);
+	});
+	suite.run("write_rect_paddle", 200000, [&](){
+		a.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, 10, 0);
+	});
+	suite.run("write_rect_large", 5000, [&](){
+		a.writeRect(100, 40, 10, 10);
+	});
+}
+
+// benchDrawContext: clear, draw and swap of whole frames at increasing scene complexity
+void benchDrawContext(Bench::Suite& suite){
+	const int objects[] = {3, 8, 16};
+	for(int i = 0; i < 3; i++){
+		for(int moving = 0; moving < 2; moving++){
+			OLED::DrawContext context;
+			int frame = 0;
+			std::string name = std::string("frame_diff_") + (moving ? "moving_" : "static_") + std::to_string(objects[i]);
+			suite.run(name, 5000, [&](){
+				writeScene(context, objects[i], moving != 0, frame++);
+				context.clear();
+				context.draw();
+				context.swapBuffers();
+			});
+		}
+	}
+	OLED::DrawContext context;
+	int frame = 0;
+	suite.run("frame_diff_full_screen", 500, [&](){
+		if(frame++%2 == 0){
+			context.writeRect(OLED::SCREEN_WIDTH - 2, OLED::SCREEN_HEIGHT - 2, 0, 0);
+		}
+		context.clear();
+		context.draw();
+		context.swapBuffers();
+	});
+}
+
+// benchPanel: frame_diff_moving_3 on a PANEL sized draw context with the game objects scaled to the panel, drawn to
+// a mock display of its own (checkDirtyRegions expects the last one blank) which is large enough for every panel
+template<typename PANEL>
+void benchPanel(Bench::Suite& suite, const std::string& name){
+	typedef Layout<PANEL> PanelLayout;
+	OLED::BasicDrawContext<PANEL> context(HAL::display(HAL::MAX_DISPLAYS - 2));
+	int frame = 0;
+	suite.run(name, 5000, [&](){
+		int offset = frame++%8;
+		context.writeRect(PanelLayout::PADDLE_WIDTH, PanelLayout::PADDLE_HEIGHT, PANEL::WIDTH/2 + offset, 0);
+		context.writeRect(PanelLayout::PADDLE_WIDTH, PanelLayout::PADDLE_HEIGHT, PANEL::WIDTH/2 - offset, PANEL::HEIGHT - PanelLayout::PADDLE_HEIGHT - 1);
+		context.writeRect(PanelLayout::BALL_SIZE, PanelLayout::BALL_SIZE, PANEL::WIDTH/4 + offset, PANEL::HEIGHT/2 + offset/2);
+		context.clear();
+		context.draw();
+		context.swapBuffers();
+	});
+}
+
+// checkDirtyRegions: draws randomly placed rectangles through a DrawContext every frame and compares each pixel of a
+// mock display with the rectangles, skipping columns outside the dirty regions must never leave a pixel stale
+bool checkDirtyRegions(Bench::Suite& suite){
+	if(!suite.selected("dirty_")){
+		return true;
+	}
+	const int FRAMES = 2000;
+	const int RECTS = 4;
+	HAL::Display& display = HAL::display(HAL::MAX_DISPLAYS - 1);
+	OLED::DrawContext context(display);
+	long mismatches = 0;
+	for(int frame = 0; frame < FRAMES; frame++){
+		int x[RECTS], y[RECTS], width[RECTS], height[RECTS];
+		for(int i = 0; i < RECTS; i++){
+			width[i] = 1 + rand()%24;
+			height[i] = 1 + rand()%24;
+			x[i] = rand()%(OLED::SCREEN_WIDTH - width[i] - 1);
+			y[i] = rand()%(OLED::SCREEN_HEIGHT - height[i] - 1);
+			context.writeRect(width[i], height[i], x[i], y[i]);
+		}
+		context.clear();
+		context.draw();
+		context.swapBuffers();
+		for(int py = 0; py < OLED::SCREEN_HEIGHT; py++){
+			for(int px = 0; px < OLED::SCREEN_WIDTH; px++){
+				bool expected = false;
+				for(int i = 0; i < RECTS; i++){
+					expected = expected || (px >= x[i] && px < x[i] + width[i] && py >= y[i] && py < y[i] + height[i]);
+				}
+				if(display.pixel(px, py) != expected){
+					mismatches++;
+				}
+			}
+		}
+	}
+	suite.add("dirty_region_mismatches", FRAMES, mismatches, mismatches, "pixels");
+	return mismatches == 0;
+}
+
+// checkFramebuffer: publishes frames filled with their frame number from a writer thread while the main thread reads
+// them in place through a read-only mapping of the same file like an external viewer, every frame the sequence lock
+// accepts must be whole, then times publishing one frame
+bool checkFramebuffer(Bench::Suite& suite){
+	if(!suite.selected("framebuffer_")){
+		return true;
+	}
+	char path[] = "/tmp/pongBenchFramesXXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0){
+		std::cerr << "framebuffer: failed to create frames file: " << strerror(errno) << std::endl;
+		return false;
+	}
+	close(fd);
+	const Framebuffer::Frames* frames = NULL;
+	if(!Framebuffer::publish(path, OLED::SCREEN_WIDTH, OLED::NUM_ROWS) || (frames = Framebuffer::map(path)) == NULL){
+		std::cerr << "framebuffer: failed to map frames file: " << strerror(errno) << std::endl;
+		unlink(path);
+		return false;
+	}
+	const int FRAMES = 200000;
+	const int SIZE = OLED::SCREEN_WIDTH*OLED::NUM_ROWS;
+	Framebuffer::Ring* ring = Framebuffer::ring(0);
+	std::atomic<bool> done(false);
+	std::thread writer([&](){
+		uint8_t pixels[Framebuffer::MAX_FRAME_BYTES];
+		for(int frame = 0; frame < FRAMES; frame++){
+			memset(pixels, frame & 0xFF, SIZE);
+			ring->publish(pixels, SIZE, Metrics::nowMicros());
+		}
+		done = true;
+	});
+	long accepted = 0;
+	long rejected = 0;	// Reads discarded because the writer reused the slot meanwhile
+	long torn = 0;		// Accepted reads that weren't a single whole frame
+	while(!done){
+		uint32_t sequence;
+		const Framebuffer::Slot* slot = Framebuffer::latest(frames->ring[0], sequence);
+		if(slot == NULL){
+			continue;
+		}
+		uint8_t expected = slot->frame & 0xFF;
+		bool whole = true;
+		for(int i = 0; i < SIZE; i++){
+			whole = whole && slot->pixels[i] == expected;
+		}
+		if(!Framebuffer::unchanged(slot, sequence)){
+			rejected++;
+			continue;
+		}
+		accepted++;
+		if(!whole){
+			torn++;
+		}
+	}
+	writer.join();
+	suite.add("framebuffer_torn_frames", accepted, torn, torn, "frames");
+	suite.add("framebuffer_rejected_reads", accepted + rejected, rejected, rejected, "reads");
+	uint8_t pixels[Framebuffer::MAX_FRAME_BYTES] = {0};
+	suite.run("framebuffer_publish", 100000, [&](){
+		ring->publish(pixels, SIZE, 0);
+	});
+	Framebuffer::unpublish();
+	munmap((void*)frames, sizeof(Framebuffer::Frames));
+	unlink(path);
+	return torn == 0;
+}
+
+// benchFilters: Stats and Ultrasonic functions run on every sensor sample
+void benchFilters(Bench::Suite& suite){
+	const float samples[5] = {0.21f, 0.19f, 0.25f, 0.2f, 0.22f};
+	Real distances[5] = {samples[0], samples[1], samples[2], samples[3], samples[4]};
+	suite.run("stats_average", 1000000, [&](){
+		Real average = Stats::average<Real>(distances, 5);
+		Bench::doNotOptimize(average);
+	});
+	suite.run("stats_sample_stddev", 1000000, [&](){
+		Real stddev = Stats::sampleStandardDeviation<Real>(distances, 5);
+		Bench::doNotOptimize(stddev);
+	});
+	suite.run("stats_population_stddev", 1000000, [&](){
+		Real stddev = Stats::populationStandardDeviation<Real>(distances, 5);
+		Bench::doNotOptimize(stddev);
+	});
+	const double readings[Ultrasonic::INTERPOLATION_SAMPLES] = {0.21, 0.35, 0.19, 0.2, 0.45, 0.22, 0.18, 0.2, 0.23};
+	double data[Ultrasonic::INTERPOLATION_SAMPLES];
+	suite.run("stats_quicksort", 500000, [&](){
+		memcpy(data, readings, sizeof(readings));
+		Stats::quicksort<double>(data, Ultrasonic::INTERPOLATION_SAMPLES);
+		Bench::doNotOptimize(data);
+	});
+	suite.run("ultrasonic_interpolate", 500000, [&](){
+		memcpy(data, readings, sizeof(readings));
+		double distance = Ultrasonic::interpolate(data);
+		Bench::doNotOptimize(distance);
+	});
+	suite.run("ultrasonic_screen_x", 1000000, [&](){
+		Real x = Ultrasonic::convertToScreenXCoord(distances[0]);
+		Bench::doNotOptimize(x);
+	});
+	PongPaddle paddle;
+	int sample = 0;
+	suite.run("paddle_running_average", 1000000, [&](){
+		paddle.updateRunningAverage(samples[sample++%5]);
+		Real x = Ultrasonic::convertToScreenXCoord(paddle.runningAverage);
+		int column = Ultrasonic::paddleColumn(x, PADDLE_DIM.x);
+		Bench::doNotOptimize(column);
+	});
+	Ultrasonic::ColumnTable columns(PADDLE_DIM.x);
+	uint32_t echoes[5];
+	for(int i = 0; i < 5; i++){
+		echoes[i] = Ultrasonic::distanceToEcho(samples[i]);
+	}
+	suite.run("paddle_echo_average", 1000000, [&](){
+		paddle.updateEchoAverage(echoes[sample++%5]);
+		int column = paddle.echoColumn(columns, false);
+		Bench::doNotOptimize(column);
+	});
+	uint32_t echo = 0;
+	suite.run("column_float", 1000000, [&](){
+		Real x = Ultrasonic::convertToScreenXCoord(Ultrasonic::echoToDistance(echo));
+		int column = Ultrasonic::paddleColumn(x, PADDLE_DIM.x);
+		echo = (echo + 7)%Ultrasonic::MAX_ECHO_MICROS;
+		Bench::doNotOptimize(column);
+	});
+	suite.run("column_lut", 1000000, [&](){
+		int column = columns.column(echo, false);
+		echo = (echo + 7)%Ultrasonic::MAX_ECHO_MICROS;
+		Bench::doNotOptimize(column);
+	});
+}
+
+// checkColumns: compares the echo time lookup table and integer filter against the float reference path and feeds
+// the filter an echo far out of range, returns false if a column is off by more than one pixel or an echo isn't clamped
+bool checkColumns(Bench::Suite& suite){
+	if(!suite.selected("column_")){
+		return true;
+	}
+	Ultrasonic::ColumnTable columns(PADDLE_DIM.x);
+	int maxError = 0;
+	long mismatches = 0;
+	long checked = 0;
+	for(uint32_t echo = 0; echo <= Ultrasonic::MAX_ECHO_MICROS + 100; echo++){
+		Real x = Ultrasonic::convertToScreenXCoord(Ultrasonic::echoToDistance(echo));
+		for(int mirrored = 0; mirrored < 2; mirrored++){
+			int expected = Ultrasonic::paddleColumn(mirrored ? OLED::SCREEN_WIDTH - x : x, PADDLE_DIM.x);
+			int error = abs(columns.column(echo, mirrored != 0) - expected);
+			maxError = std::max(maxError, error);
+			mismatches += error != 0;
+			checked++;
+		}
+	}
+	suite.add("column_lut_max_error", checked, maxError, maxError, "px");
+	suite.add("column_lut_mismatches", checked, mismatches, mismatches, "columns");
+	// Same noisy sweep through both filters
+	PongPaddle reference;
+	PongPaddle paddle;
+	int maxFilterError = 0;
+	const long steps = 4000;
+	for(long i = 0; i < steps; i++){
+		float distance = 0.05f + 0.35f*(i%400 < 200 ? i%200 : 200 - i%200)/200 + 0.002f*(rand()%3 - 1);
+		reference.updateRunningAverage(distance);
+		paddle.updateEchoAverage(Ultrasonic::distanceToEcho(distance));
+		int expected = Ultrasonic::paddleColumn(Ultrasonic::convertToScreenXCoord(reference.runningAverage), PADDLE_DIM.x);
+		maxFilterError = std::max(maxFilterError, abs(paddle.echoColumn(columns, false) - expected));
+	}
+	suite.add("column_filter_max_error", steps, maxFilterError, maxFilterError, "px");
+	// Remote distances reach 65.534m, far past any echo the sensors report, the filter must clamp them before squaring
+	PongPaddle remote;
+	for(int i = 0; i < 4; i++){
+		remote.updateEchoAverage(1000);
+	}
+	remote.updateEchoAverage(Ultrasonic::distanceToEcho(65.534f));
+	long outOfRange = 0;
+	for(int i = 0; i < 5; i++){
+		outOfRange += remote.previousEchoes[i] < 0 || remote.previousEchoes[i] > (int32_t)Ultrasonic::MAX_ECHO_MICROS;
+	}
+	outOfRange += remote.echoAverage < 0 || remote.echoAverage/ECHO_AVERAGE_SCALE > (int32_t)Ultrasonic::MAX_ECHO_MICROS;
+	suite.add("column_out_of_range_echoes", 5, outOfRange, outOfRange, "echoes");
+#ifdef FIXED_POINT
+	// Squared deviations of centimetre spreads are a few raw units in Q16 so the fixed-point reference filter's
+	// outlier clamp drifts from the integer filter's, only the table is checked
+	return maxError <= 1 && outOfRange == 0;
+#else
+	return maxError <= 1 && maxFilterError <= 1 && outOfRange == 0;
+#endif
+}
+
+// benchSensor: simulated HC-SR04 readings, dominated by the simulated echo time
+void benchSensor(Bench::Suite& suite){
+	if(!suite.selected("sensor_")){
+		return;
+	}
+	bool err = false;
+	Ultrasonic::Sensor sensor(err, BENCH_TRIGGER, BENCH_ECHO);
+	if(err){
+		return;
+	}
+	HAL::Gpio::setDistance(BENCH_ECHO, BENCH_DISTANCE);
+	suite.run("sensor_reading", 100, [&](){
+		double distance = sensor.reading();
+		Bench::doNotOptimize(distance);
+	});
+	suite.run("sensor_read_interpolated", 10, [&](){
+		double distance = sensor.readInterpolated();
+		Bench::doNotOptimize(distance);
+	});
+	sensor.free();
+}
+
+// measureJitter: measures JITTER_READINGS echo times of a fixed simulated distance on a sensor thread that applies the
+// real-time profile if it is enabled, while busy threads load every CPU, returns false if the profile was refused
+bool measureJitter(Ultrasonic::Sensor& sensor, std::vector<double>& echoes){
+	std::atomic<bool> loading(true);
+	std::vector<std::thread> load;
+	for(int i = 0; i < JITTER_LOAD_PER_CPU*Realtime::cpuCount(); i++){
+		load.push_back(std::thread([&loading](){
+			volatile uint64_t spins = 0;
+			while(loading.load(std::memory_order_relaxed)){
+				spins++;
+			}
+		}));
+	}
+	bool applied = true;
+	std::thread reader([&](){
+		applied = Realtime::apply(Realtime::ROLE_SENSOR);
+		for(int i = 0; i < JITTER_READINGS; i++){
+			uint32_t echo = sensor.echoMicros();
+			if(echo != Ultrasonic::NO_ECHO){
+				echoes.push_back(echo);
+			}
+		}
+	});
+	reader.join();
+	loading.store(false);
+	for(size_t i = 0; i < load.size(); i++){
+		load[i].join();
+	}
+	std::sort(echoes.begin(), echoes.end());
+	return applied;
+}
+
+// addJitter: reports spread of sorted echo times in microseconds
+void addJitter(Bench::Suite& suite, const std::string& name, const std::vector<double>& echoes){
+	double mean = 0;
+	for(size_t i = 0; i < echoes.size(); i++){
+		mean += echoes[i];
+	}
+	mean /= echoes.size();
+	double variance = 0;
+	for(size_t i = 0; i < echoes.size(); i++){
+		variance += (echoes[i] - mean)*(echoes[i] - mean);
+	}
+	double stddev = sqrt(variance/echoes.size());
+	suite.add(name + "_stddev", echoes.size(), stddev, stddev, "us");
+	double spread = percentile(echoes, 99) - percentile(echoes, 1);
+	suite.add(name + "_p1_p99_spread", echoes.size(), spread, spread, "us");
+	spread = echoes.back() - echoes.front();
+	suite.add(name + "_max_spread", echoes.size(), spread, spread, "us");
+}
+
+// benchSensorJitter: spread of echo times measured under background load with the real-time profile off and on,
+// the mock's echo widths have +-12us of noise so anything wider is scheduling
+void benchSensorJitter(Bench::Suite& suite){
+	if(!suite.selected("jitter_")){
+		return;
+	}
+	bool err = false;
+	Ultrasonic::Sensor sensor(err, BENCH_TRIGGER, BENCH_ECHO);
+	if(err){
+		return;
+	}
+	HAL::Gpio::setDistance(BENCH_ECHO, BENCH_DISTANCE);
+	std::vector<double> echoes;
+	measureJitter(sensor, echoes);
+	if(!echoes.empty()){
+		addJitter(suite, "jitter_normal", echoes);
+	}
+	echoes.clear();
+	Realtime::enable();
+	bool applied = measureJitter(sensor, echoes);
+	Realtime::disable();
+	if(!applied){
+		std::cerr << "jitter: real-time profile refused (needs CAP_SYS_NICE), skipping jitter_realtime: " << strerror(errno) << std::endl;
+	}
+	else if(!echoes.empty()){
+		addJitter(suite, "jitter_realtime", echoes);
+	}
+	HAL::Gpio::setDistance(BENCH_ECHO, std::numeric_limits<float>::quiet_NaN());
+	sensor.free();
+}
+
+// checkMappedGpio: maps a temporary file standing in for the gpio registers, writes random levels to its data registers
+// through a second mapping and checks every pin reads back through GpioMap and a sensor's echo polling, then times a
+// mapped read against reading the file with a system call per sample like ugpio's sysfs reads
+bool checkMappedGpio(Bench::Suite& suite){
+	if(!suite.selected("gpiomem_")){
+		return true;
+	}
+	char path[] = "/tmp/pongBenchGpioXXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0 || ftruncate(fd, GpioMap::MAP_SIZE) != 0){
+		std::cerr << "gpiomem: failed to create register stand-in: " << strerror(errno) << std::endl;
+		return false;
+	}
+	uint8_t* registers = (uint8_t*)mmap(NULL, GpioMap::MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(registers == MAP_FAILED || !GpioMap::map(path)){
+		std::cerr << "gpiomem: failed to map register stand-in: " << strerror(errno) << std::endl;
+		close(fd);
+		unlink(path);
+		return false;
+	}
+	volatile uint32_t* data = (volatile uint32_t*)(registers + GpioMap::DATA_OFFSET);
+	bool err = false;
+	Ultrasonic::Sensor sensor(err, BENCH_TRIGGER, BENCH_ECHO);
+	const int PATTERNS = 1000;
+	long mismatches = 0;
+	for(int i = 0; i < PATTERNS; i++){
+		for(int r = 0; r < GpioMap::MAX_PINS/32; r++){
+			data[r] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		}
+		for(int pin = 0; pin < GpioMap::MAX_PINS; pin++){
+			int expected = (data[pin/32] >> (pin%32)) & 1;
+			if(GpioMap::getValue(pin) != expected){
+				mismatches++;
+			}
+		}
+		if(!err && sensor.echoValue() != (int)((data[BENCH_ECHO/32] >> (BENCH_ECHO%32)) & 1)){
+			mismatches++;
+		}
+	}
+	suite.add("gpiomem_mismatches", PATTERNS, mismatches, mismatches, "pins");
+	suite.run("gpiomem_read_mapped", 1000000, [&](){
+		int value = sensor.echoValue();
+		Bench::doNotOptimize(value);
+	});
+	suite.run("gpiomem_read_syscall", 20000, [&](){
+		uint32_t value = 0;
+		ssize_t read = pread(fd, &value, sizeof(value), GpioMap::DATA_OFFSET);
+		Bench::doNotOptimize(read);
+		Bench::doNotOptimize(value);
+	});
+	if(!err){
+		sensor.free();
+	}
+	GpioMap::unmap();
+	munmap(registers, GpioMap::MAP_SIZE);
+	close(fd);
+	unlink(path);
+	return mismatches == 0;
+}
+
+// benchUpdate: ball physics and collisions of one playing frame, the arithmetic fixed-point replaces
+void benchUpdate(Bench::Suite& suite){
+	if(!suite.selected("game_update")){
+		return;
+	}
+	MotionPong pongGame(CPU_VS_CPU);
+	pongGame.init();
+	pongGame.reset<CPU_VS_CPU>();
+	suite.run("game_update_cvc", 100000, [&](){
+		if(pongGame.roundState() != ROUND_PLAYING || pongGame.shouldClose()){
+			pongGame.enterState(ROUND_SERVE);
+		}
+		pongGame.update<CPU_VS_CPU>();
+	});
+}
+
+// benchStartup: time from constructing a game of game-mode MODE to its first drawn frame, includes bringing up the
+// display and settling the simulated sensors
+template<Gamemode MODE>
+void benchStartup(Bench::Suite& suite, const std::string& name){
+	if(!suite.selected(name)){
+		return;
+	}
+	std::vector<double> times;
+	for(int r = 0; r < suite.repeats(); r++){
+		int64_t start = Bench::nowNanos();
+		MotionPong pongGame(MODE);
+		pongGame.init();
+		pongGame.update<MODE>();
+		pongGame.draw<MODE>();
+		times.push_back((Bench::nowNanos() - start)/1e6);
+	}
+	std::sort(times.begin(), times.end());
+	suite.add(name, 1, times[times.size()/2], times[0], "ms");
+}
+
+// displayedColumn: leftmost lit column of the mock display's top pixel row, where paddle 1 is drawn, -1 if none
+int displayedColumn(){
+	for(int x = 0; x < OLED::SCREEN_WIDTH; x++){
+		if(HAL::display().pixel(x, 0)){
+			return x;
+		}
+	}
+	return -1;
+}
+
+// stepFrame: one player-vs-player frame held in the ready-check so no ball or text is drawn
+void stepFrame(MotionPong& pongGame){
+	pongGame.enterState(ROUND_READY_CHECK);
+	pongGame.update<PLAYER_VS_PLAYER>();
+	pongGame.draw<PLAYER_VS_PLAYER>();
+	Metrics::endFrame();
+}
+
+// benchStepResponse: jumps the simulated hand of paddle 1 between STEP_NEAR and STEP_FAR and times the mock display
+// until the paddle first moves and until it is within a pixel of its new column, then reports the game's own
+// motion-to-photon latency over the same frames
+void benchStepResponse(Bench::Suite& suite){
+	if(!suite.selected("step_")){
+		return;
+	}
+	MotionPong pongGame(PLAYER_VS_PLAYER);
+	pongGame.init();
+	Ultrasonic::ColumnTable columns(PADDLE_DIM.x);
+	HAL::Gpio::setDistance(US_ONE_ECHO, STEP_NEAR);
+	int64_t start = Bench::nowNanos();
+	int target = columns.column(Ultrasonic::distanceToEcho(STEP_NEAR), false);
+	while(abs(displayedColumn() - target) > 1 && Bench::nowNanos() - start < STEP_TIMEOUT_NANOS){
+		stepFrame(pongGame);
+	}
+	Metrics::Histogram& latency = Metrics::stats()->motionToPhoton;
+	new (&latency) Metrics::Histogram();
+	std::vector<double> responses;
+	std::vector<double> settles;
+	for(int step = 0; step < 2*suite.repeats(); step++){
+		float distance = step%2 == 0 ? STEP_FAR : STEP_NEAR;
+		target = columns.column(Ultrasonic::distanceToEcho(distance), false);
+		int before = displayedColumn();
+		double response = -1;
+		start = Bench::nowNanos();
+		HAL::Gpio::setDistance(US_ONE_ECHO, distance);
+		while(Bench::nowNanos() - start < STEP_TIMEOUT_NANOS){
+			stepFrame(pongGame);
+			int column = displayedColumn();
+			double elapsed = (Bench::nowNanos() - start)/1e6;
+			if(response < 0 && column != before){
+				response = elapsed;
+				responses.push_back(response);
+			}
+			if(abs(column - target) <= 1){
+				settles.push_back(elapsed);
+				break;
+			}
+		}
+	}
+	HAL::Gpio::setDistance(US_ONE_ECHO, std::numeric_limits<float>::quiet_NaN());
+	if(responses.empty() || settles.empty()){
+		std::cerr << "step response: paddle never moved" << std::endl;
+		return;
+	}
+	std::sort(responses.begin(), responses.end());
+	std::sort(settles.begin(), settles.end());
+	suite.add("step_first_response_p50", responses.size(), percentile(responses, 50), responses[0], "ms");
+	suite.add("step_first_response_p90", responses.size(), percentile(responses, 90), responses[0], "ms");
+	suite.add("step_settle_p50", settles.size(), percentile(settles, 50), settles[0], "ms");
+	suite.add("step_settle_p90", settles.size(), percentile(settles, 90), settles[0], "ms");
+	// Histogram percentiles are power of two bucket upper bounds
+	suite.add("step_motion_to_photon_p50", latency.count.load(), latency.percentile(50), latency.percentile(50), "us");
+	suite.add("step_motion_to_photon_p99", latency.count.load(), latency.percentile(99), latency.percentile(99), "us");
+}
+
+// checkAllocations: counts heap allocations of every thread over frames steady-state frames of game-mode MODE after
+// warm-up frames, returns false if the frame loop allocated
+template<Gamemode MODE>
+bool checkAllocations(Bench::Suite& suite, const std::string& name, long warmup, long frames){
+	if(!suite.selected(name)){
+		return true;
+	}
+	MotionPong pongGame(MODE);
+	pongGame.init();
+	pongGame.reset<MODE>();
+	long drawn = 0;
+	uint64_t allocations = 0;
+	while(drawn < warmup + frames && !pongGame.shouldClose()){
+		if(drawn == warmup){
+			allocations = Bench::allocationCount().load();
+		}
+		if(pongGame.roundState() != ROUND_PLAYING){
+			pongGame.enterState(ROUND_SERVE);
+		}
+		pongGame.update<MODE>();
+		pongGame.draw<MODE>();
+		Metrics::endFrame();
+		drawn++;
+	}
+	if(drawn <= warmup){
+		std::cerr << name << ": game closed during warm-up" << std::endl;
+		return false;
+	}
+	allocations = Bench::allocationCount().load() - allocations;
+	suite.add(name, drawn - warmup, (double)allocations, (double)allocations, "allocs");
+	return allocations == 0;
+}
+
+// benchFrames: whole frames per second of game-mode MODE, rounds are served immediately so every frame is a playing frame
+template<Gamemode MODE>
+void benchFrames(Bench::Suite& suite, const std::string& name, long frames){
+	if(!suite.selected(name)){
+		return;
+	}
+	MotionPong pongGame(MODE);
+	pongGame.init();
+	pongGame.reset<MODE>();
+	std::vector<std::pair<double, double> > rates;
+	for(int r = 0; r <= suite.repeats() && !pongGame.shouldClose(); r++){
+		uint64_t cycles = Bench::cycleCounter().read();
+		int64_t start = Bench::nowNanos();
+		long drawn = 0;
+		while(drawn < frames && !pongGame.shouldClose()){
+			if(pongGame.roundState() != ROUND_PLAYING){
+				pongGame.enterState(ROUND_SERVE);
+			}
+			pongGame.update<MODE>();
+			pongGame.draw<MODE>();
+			Metrics::endFrame();
+			drawn++;
+		}
+		// First batch warms up
+		if(r > 0 && drawn > 0){
+			int64_t elapsed = Bench::nowNanos() - start;
+			cycles = Bench::cycleCounter().read() - cycles;
+			rates.push_back(std::make_pair(drawn*1e9/elapsed, (double)cycles/drawn));
+		}
+	}
+	if(rates.empty()){
+		return;
+	}
+	std::sort(rates.begin(), rates.end());
+	const std::pair<double, double>& median = rates[rates.size()/2];
+	suite.add(name, frames, median.first, rates.back().first, "frames/s", Bench::cycleCounter().available() ? median.second : -1.0);
+}
+
+// checkSimulation: plays whole cpu-vs-cpu games under a virtual clock (see clock.h) advanced SIM_FRAME_MICROS every
+// frame, countdowns pass instantly and the physics step by simulated time, reports simulated seconds played per real
+// second and returns false if a game didn't finish within SIM_MAX_FRAMES frames
+bool checkSimulation(Bench::Suite& suite){
+	if(!suite.selected("sim_")){
+		return true;
+	}
+	Clock::VirtualClock clock;
+	Clock::use(&clock);
+	long frames = 0;
+	long unfinished = 0;
+	int64_t simulated = 0;
+	int64_t start = Bench::nowNanos();
+	for(int i = 0; i < SIM_GAMES; i++){
+		MotionPong pongGame(CPU_VS_CPU);
+		pongGame.init();
+		pongGame.reset<CPU_VS_CPU>();
+		int64_t began = Clock::micros();
+		long drawn = 0;
+		while(!pongGame.shouldClose() && drawn < SIM_MAX_FRAMES){
+			pongGame.update<CPU_VS_CPU>();
+			pongGame.draw<CPU_VS_CPU>();
+			Metrics::endFrame();
+			clock.advance(SIM_FRAME_MICROS);
+			drawn++;
+		}
+		if(!pongGame.shouldClose()){
+			unfinished++;
+		}
+		simulated += Clock::micros() - began;
+		frames += drawn;
+	}
+	int64_t elapsed = Bench::nowNanos() - start;
+	Clock::use(NULL);
+	double speedup = simulated*1000.0/elapsed;
+	suite.add("sim_cvc_speedup", frames, speedup, speedup, "x");
+	suite.add("sim_cvc_seconds_per_game", SIM_GAMES, simulated/1e6/SIM_GAMES, simulated/1e6/SIM_GAMES, "s");
+	suite.add("sim_unfinished_games", SIM_GAMES, unfinished, unfinished, "games");
+	return unfinished == 0;
+}
+
+// benchTables: total and slowest table frames per second of tables tables of game-mode MODE stepped by the table
+// scheduler, every table draws frames frames per repeat with rounds served immediately, batches in which a game ended
+// aren't counted
+template<Gamemode MODE>
+void benchTables(Bench::Suite& suite, const std::string& name, int tables, long frames){
+	if(!suite.selected(name)){
+		return;
+	}
+	TableScheduler scheduler(MODE, tables);
+	scheduler.init();
+	volatile sig_atomic_t stop = 0;
+	std::vector<double> totals;
+	std::vector<double> slowest;
+	bool open = true;
+	for(int r = 0; r <= suite.repeats() && open; r++){
+		int64_t start = Bench::nowNanos();
+		scheduler.run<MODE>(stop, frames, true);
+		int64_t elapsed = Bench::nowNanos() - start;
+		long drawn = 0;
+		long fewest = frames;
+		for(int i = 0; i < tables; i++){
+			drawn += scheduler.frames(i);
+			fewest = scheduler.frames(i) < fewest ? scheduler.frames(i) : fewest;
+			open = open && !scheduler.table(i).shouldClose();
+		}
+		// First batch warms up
+		if(r > 0 && open && elapsed > 0){
+			totals.push_back(drawn*1e9/elapsed);
+			slowest.push_back(fewest*1e9/elapsed);
+		}
+	}
+	if(totals.empty()){
+		return;
+	}
+	std::sort(totals.begin(), totals.end());
+	std::sort(slowest.begin(), slowest.end());
+	suite.add(name + "_total", frames*tables, totals[totals.size()/2], totals.back(), "frames/s");
+	suite.add(name + "_per_table", frames, slowest[slowest.size()/2], slowest.back(), "frames/s");
+}
+
+int main(int argc, char* argv[]){
+	std::string output = "bench_results.json";
+	std::string filter;
+	std::string commit = "unknown";
+	int repeats = Bench::DEFAULT_REPEATS;
+	for(int i = 1; i + 1 < argc; i += 2){
+		std::string arg(argv[i]);
+		if(arg == "--output"){
+			output = argv[i + 1];
+		}
+		else if(arg == "--filter"){
+			filter = argv[i + 1];
+		}
+		else if(arg == "--repeats"){
+			repeats = atoi(argv[i + 1]);
+		}
+		else if(arg == "--commit"){
+			commit = argv[i + 1];
+		}
+		else{
+			std::cerr << "usage: " << argv[0] << " [--output path] [--filter name] [--repeats n] [--commit id]" << std::endl;
+			return -1;
+		}
+	}
+	if(argc%2 == 0 || repeats < 1){
+		std::cerr << "usage: " << argv[0] << " [--output path] [--filter name] [--repeats n] [--commit id]" << std::endl;
+		return -1;
+	}
+	srand(1);
+
+	Bench::Suite suite(filter, repeats);
+	benchImage(suite);
+	benchDrawContext(suite);
+	benchPanel<OLED::Panel128x32>(suite, "panel_128x32_frame_diff_moving_3");
+	benchPanel<OLED::Panel72x40>(suite, "panel_72x40_frame_diff_moving_3");
+	bool regionsMatch = checkDirtyRegions(suite);
+	bool framesWhole = checkFramebuffer(suite);
+	benchFilters(suite);
+	bool columnsMatch = checkColumns(suite);
+	benchSensor(suite);
+	benchSensorJitter(suite);
+	bool registersMatch = checkMappedGpio(suite);
+	benchUpdate(suite);
+	benchStartup<PLAYER_VS_PLAYER>(suite, "startup_first_frame_pvp");
+	benchStepResponse(suite);
+	bool noAllocations = checkAllocations<CPU_VS_CPU>(suite, "alloc_frames_cvc", 100, 2000);
+	noAllocations = checkAllocations<PLAYER_VS_PLAYER>(suite, "alloc_frames_pvp", 5, 30) && noAllocations;
+	benchFrames<CPU_VS_CPU>(suite, "game_fps_cvc", 2000);
+	benchFrames<PLAYER_VS_PLAYER>(suite, "game_fps_pvp", 50);
+	benchTables<CPU_VS_CPU>(suite, "tables_1_cvc", 1, 2000);
+	benchTables<CPU_VS_CPU>(suite, "tables_2_cvc", 2, 2000);
+	benchTables<CPU_VS_CPU>(suite, "tables_4_cvc", 4, 2000);
+	benchTables<PLAYER_VS_PLAYER>(suite, "tables_4_pvp", 4, 10);
+	bool simulationFinished = checkSimulation(suite);
+
+	if(!suite.write(output, commit, REAL_NAME)){
+		std::cerr << "failed to write results to: " << output << std::endl;
+		return -1;
+	}
+	if(!noAllocations){
+		std::cerr << "game frame loop allocated after warm-up" << std::endl;
+		return -1;
+	}
+	if(!framesWhole){
+		std::cerr << "a frame read through the framebuffer ring was torn" << std::endl;
+		return -1;
+	}
+	if(!regionsMatch){
+		std::cerr << "display differs from the drawn frames after skipping clean columns" << std::endl;
+		return -1;
+	}
+	if(!registersMatch){
+		std::cerr << "pins read through the mapped gpio registers differ from the values written" << std::endl;
+		return -1;
+	}
+	if(!columnsMatch){
+		std::cerr << "echo time lookup table differs from the float path by more than one pixel or an out of range echo wasn't clamped" << std::endl;
+		return -1;
+	}
+	if(!simulationFinished){
+		std::cerr << "a game simulated under the virtual clock didn't finish" << std::endl;
+		return -1;
+	}
+	return 0;
+}
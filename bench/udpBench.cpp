@@ -0,0 +1,142 @@
+/*///////////////////////////////////////
+// udpBench: loopback latency and throughput
+// benchmark for remote paddle input, a sender
+// thread streams packets (optionally dropping
+// and reordering them) to a PaddleReceiver
+// polled like the game loop does
+//
+// usage: udpBench [--packets n] [--rate hz] [--jitter ms] [--loss percent] [--reorder percent] [--port port]
+*/
+
+#include "network.h"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+// percentile: returns p'th percentile of sorted latencies
+int64_t percentile(const std::vector<int64_t>& sorted, float p){
+	if(sorted.empty()){
+		return 0;
+	}
+	size_t index = (size_t)(p/100.0f*(sorted.size() - 1));
+	return sorted[index];
+}
+
+int main(int argc, char* argv[]){
+	int packets = 100000;
+	int rate = 0; // 0 sends as fast as possible
+	int jitter = 0;
+	int loss = 0;
+	int reorder = 0;
+	int port = Network::DEFAULT_PORT + 1;
+	for(int i = 1; i + 1 < argc; i += 2){
+		std::string arg(argv[i]);
+		int value = atoi(argv[i + 1]);
+		if(arg == "--packets"){
+			packets = value;
+		}
+		else if(arg == "--rate"){
+			rate = value;
+		}
+		else if(arg == "--jitter"){
+			jitter = value;
+		}
+		else if(arg == "--loss"){
+			loss = value;
+		}
+		else if(arg == "--reorder"){
+			reorder = value;
+		}
+		else if(arg == "--port"){
+			port = value;
+		}
+		else{
+			std::cerr << "usage: " << argv[0] << " [--packets n] [--rate hz] [--jitter ms] [--loss percent] [--reorder percent] [--port port]" << std::endl;
+			return -1;
+		}
+	}
+
+	Network::PaddleReceiver receiver;
+	Network::PaddleSender sender;
+	if(!receiver.open((uint16_t)port, jitter) || !sender.open("127.0.0.1", (uint16_t)port)){
+		return -1;
+	}
+
+	std::atomic<bool> done(false);
+	std::thread sendThread([&](){
+		srand(1);
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		Network::PaddlePacket held;
+		bool holding = false;
+		for(int i = 0; i < packets; i++){
+			Network::PaddlePacket packet;
+			packet.paddle = 0;
+			packet.sequence = (uint32_t)i;
+			packet.distance = (uint16_t)(50 + i%350);
+			packet.sendTime = (uint32_t)Network::nowMicros();
+			if(rand()%100 < loss){
+				continue;
+			}
+			if(!holding && rand()%100 < reorder){
+				// Hold packet back so it is sent after the next one
+				held = packet;
+				holding = true;
+				continue;
+			}
+			while(!sender.sendPacket(packet)){
+				std::this_thread::yield(); // Socket buffer full, receiver is behind
+			}
+			if(holding){
+				held.sendTime = (uint32_t)Network::nowMicros();
+				sender.sendPacket(held);
+				holding = false;
+			}
+			if(rate > 0){
+				next += std::chrono::microseconds(1000000/rate);
+				std::this_thread::sleep_until(next);
+			}
+		}
+		done = true;
+	});
+
+	std::vector<int64_t> latencies;
+	latencies.reserve(packets);
+	int64_t start = Network::nowMicros();
+	int64_t idleSince = 0;
+	while(true){
+		Network::PaddleSample sample;
+		if(receiver.next(0, sample)){
+			latencies.push_back((int64_t)(uint32_t)((uint32_t)Network::nowMicros() - sample.sendTime));
+			idleSince = 0;
+		}
+		else if(done){
+			// Drain until nothing has been released for longer than the jitter delay
+			if(idleSince == 0){
+				idleSince = Network::nowMicros();
+			}
+			else if(Network::nowMicros() - idleSince > (int64_t)jitter*1000 + 100000){
+				break;
+			}
+		}
+	}
+	int64_t elapsed = Network::nowMicros() - start;
+	sendThread.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	const Network::PaddleStats& stats = receiver.stats(0);
+	std::cout << "packets_sent " << packets << "\n";
+	std::cout << "packets_received " << stats.received << "\n";
+	std::cout << "packets_lost " << stats.lost << "\n";
+	std::cout << "packets_late " << stats.late << "\n";
+	std::cout << "packets_reordered " << stats.reordered << "\n";
+	std::cout << "packets_restarts " << stats.restarts << "\n";
+	std::cout << "samples_released " << latencies.size() << "\n";
+	std::cout << "throughput_packets_per_s " << (int64_t)(stats.received*1000000.0/elapsed) << "\n";
+	std::cout << "latency_p50_us " << percentile(latencies, 50) << "\n";
+	std::cout << "latency_p90_us " << percentile(latencies, 90) << "\n";
+	std::cout << "latency_p99_us " << percentile(latencies, 99) << "\n";
+	std::cout << "latency_max_us " << percentile(latencies, 100) << std::endl;
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*///////////////////////////////////////
+// clock.h: This file contains the game's
+// time base, round transitions, ball physics,
+// paddle speeds, sensor echo timing and the
+// mock sensors all read time and sleep through
+// Clock::micros and Clock::sleepUntil so the
+// source can be swapped for a virtual clock
+// that runs the game faster than real time
+//
+// The real clock is a steady clock, a virtual
+// clock only moves when it is read, advanced
+// or slept on: sleeps return at once with the
+// clock moved to their deadline, so countdowns
+// and sensor timeouts pass instantly
+//
+// Metrics, trace and log timings measure the
+// real cost of the work and stay on the steady
+// clock whichever source is in use
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace Clock{
+
+	// class Source: monotonic time in microseconds and sleeping until a time on it
+	class Source{
+	public:
+		virtual ~Source(){
+		}
+		// micros: current time in microseconds, never goes backwards
+		virtual int64_t micros() = 0;
+		// sleepUntil: returns once micros() has reached time
+		virtual void sleepUntil(int64_t time) = 0;
+	};
+
+	// class RealClock: steady clock time, sleeps block the calling thread
+	class RealClock : public Source{
+	public:
+		int64_t micros(){
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+		void sleepUntil(int64_t time){
+			std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(time)));
+		}
+	};
+
+	RealClock& realClock(){
+		static RealClock instance;
+		return instance;
+	}
+
+	// class VirtualClock: time that starts at the real clock's and moves tick microseconds on every read so polling
+	// loops (sensor echoes) finish, sleeps move it to their deadline and return at once, advance moves it by a frame
+	// or more, safe to use from several threads
+	class VirtualClock : public Source{
+	public:
+		VirtualClock(int64_t tick = 1){
+			mNow.store(realClock().micros());
+			mTick = tick;
+		}
+		int64_t micros(){
+			return mNow.fetch_add(mTick, std::memory_order_relaxed);
+		}
+		void sleepUntil(int64_t time){
+			int64_t now = mNow.load(std::memory_order_relaxed);
+			while(now < time && !mNow.compare_exchange_weak(now, time, std::memory_order_relaxed)){
+			}
+		}
+		// advance: moves the clock micros microseconds forward
+		void advance(int64_t micros){
+			mNow.fetch_add(micros, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<int64_t> mNow;		// Current time in microseconds
+		int64_t mTick;					// Microseconds each read moves the clock
+	};
+
+	// source: process wide time source, the real clock unless use selected another
+	std::atomic<Source*>& source(){
+		static std::atomic<Source*> instance(&realClock());
+		return instance;
+	}
+
+	// use: makes clock the time source of the game, NULL returns to the real clock, switch while no game or sensor
+	// threads are running as times taken from the previous source are compared with the new one
+	void use(Source* clock){
+		source().store(clock != NULL ? clock : &realClock(), std::memory_order_release);
+	}
+
+	// micros: current time of the time source in microseconds
+	int64_t micros(){
+		return source().load(std::memory_order_acquire)->micros();
+	}
+
+	// sleepUntil: sleeps until the time source reaches time
+	void sleepUntil(int64_t time){
+		source().load(std::memory_order_acquire)->sleepUntil(time);
+	}
+
+	// sleepFor: sleeps for duration on the time source
+	void sleepFor(std::chrono::microseconds duration){
+		Source* clock = source().load(std::memory_order_acquire);
+		clock->sleepUntil(clock->micros() + duration.count());
+	}
+
+	// toMicros: duration in whole microseconds, for comparing and adding chrono constants to Clock times
+	template<typename DURATION>
+	int64_t toMicros(DURATION duration){
+		return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	}
+}
+
+#endif // CLOCK_H
@@ -0,0 +1,234 @@
+/*///////////////////////////////////////
+// fixed.h: This file contains a Q-format
+// fixed-point number type, the Omega 2's MIPS
+// 24KEc has no FPU so every float operation
+// is a soft-float library call, Fixed keeps
+// the same arithmetic in 32 bit integers
+//
+// Real is the type the game physics and sensor
+// filters are instantiated with: float by
+// default or Fixed<REAL_FRACTION> when
+// FIXED_POINT is defined
+*/
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+#include <limits>
+
+// class Fixed: signed Q(31 - FRACTION).FRACTION number stored in 32 bits, multiplication and division
+// saturate at the limits instead of wrapping, addition and subtraction wrap like int
+template<int FRACTION>
+class Fixed{
+	static_assert(FRACTION > 0 && FRACTION < 31, "fixed-point fraction must leave room for a sign and integer bits");
+public:
+	static const int32_t ONE = (int32_t)1 << FRACTION;	// Raw value of 1.0
+	static const int32_t RAW_MAX = std::numeric_limits<int32_t>::max();
+	static const int32_t RAW_MIN = std::numeric_limits<int32_t>::min();
+
+	constexpr Fixed() : mRaw(0) {}
+	constexpr Fixed(int value) : mRaw(value*ONE) {}
+	// Float constructors round to nearest, constants are folded at compile time
+	constexpr Fixed(float value) : mRaw((int32_t)(value*ONE + (value < 0 ? -0.5f : 0.5f))) {}
+	constexpr Fixed(double value) : mRaw((int32_t)(value*ONE + (value < 0 ? -0.5 : 0.5))) {}
+
+	// fromRaw: fixed-point number with raw bits raw
+	static constexpr Fixed fromRaw(int32_t raw){
+		return Fixed(raw, RawTag());
+	}
+
+	// saturate: raw value clamped to the representable range
+	static constexpr Fixed saturate(int64_t raw){
+		return fromRaw(raw > RAW_MAX ? RAW_MAX : raw < RAW_MIN ? RAW_MIN : (int32_t)raw);
+	}
+
+	// saturate: converts value clamping it to the representable range instead of overflowing
+	static Fixed saturate(double value){
+		double scaled = value*ONE;
+		if(scaled >= (double)RAW_MAX){
+			return fromRaw(RAW_MAX);
+		}
+		if(scaled <= (double)RAW_MIN){
+			return fromRaw(RAW_MIN);
+		}
+		return Fixed(value);
+	}
+
+	// fromRatio: numerator/denominator without going through float, saturates on overflow or a zero denominator
+	static Fixed fromRatio(long numerator, long denominator){
+		if(denominator == 0){
+			return fromRaw(numerator < 0 ? RAW_MIN : RAW_MAX);
+		}
+		return saturate((int64_t)numerator*ONE/denominator);
+	}
+
+	constexpr int32_t raw() const{
+		return mRaw;
+	}
+	constexpr float toFloat() const{
+		return (float)mRaw/ONE;
+	}
+	// toInt: truncates towards zero like a float to int cast
+	constexpr int toInt() const{
+		return mRaw/ONE;
+	}
+	explicit constexpr operator float() const{
+		return toFloat();
+	}
+	explicit constexpr operator double() const{
+		return (double)mRaw/ONE;
+	}
+	explicit constexpr operator int() const{
+		return toInt();
+	}
+
+	friend constexpr Fixed operator-(Fixed a){
+		return fromRaw(-a.mRaw);
+	}
+	friend constexpr Fixed operator+(Fixed a, Fixed b){
+		return fromRaw(a.mRaw + b.mRaw);
+	}
+	friend constexpr Fixed operator-(Fixed a, Fixed b){
+		return fromRaw(a.mRaw - b.mRaw);
+	}
+	friend constexpr Fixed operator*(Fixed a, Fixed b){
+		return saturate(((int64_t)a.mRaw*b.mRaw)/ONE);
+	}
+	// operator/: division by zero saturates towards the sign of the dividend
+	friend constexpr Fixed operator/(Fixed a, Fixed b){
+		return b.mRaw == 0 ? fromRaw(a.mRaw < 0 ? RAW_MIN : RAW_MAX) : saturate((int64_t)a.mRaw*ONE/b.mRaw);
+	}
+	friend constexpr bool operator==(Fixed a, Fixed b){
+		return a.mRaw == b.mRaw;
+	}
+	friend constexpr bool operator!=(Fixed a, Fixed b){
+		return a.mRaw != b.mRaw;
+	}
+	friend constexpr bool operator<(Fixed a, Fixed b){
+		return a.mRaw < b.mRaw;
+	}
+	friend constexpr bool operator>(Fixed a, Fixed b){
+		return a.mRaw > b.mRaw;
+	}
+	friend constexpr bool operator<=(Fixed a, Fixed b){
+		return a.mRaw <= b.mRaw;
+	}
+	friend constexpr bool operator>=(Fixed a, Fixed b){
+		return a.mRaw >= b.mRaw;
+	}
+
+	Fixed& operator+=(Fixed other){
+		return *this = *this + other;
+	}
+	Fixed& operator-=(Fixed other){
+		return *this = *this - other;
+	}
+	Fixed& operator*=(Fixed other){
+		return *this = *this*other;
+	}
+	Fixed& operator/=(Fixed other){
+		return *this = *this/other;
+	}
+
+private:
+	struct RawTag{};
+	constexpr Fixed(int32_t raw, RawTag) : mRaw(raw) {}
+
+	int32_t mRaw;	// value*2^FRACTION
+};
+
+// abs: absolute value, saturates the most negative value
+template<int FRACTION>
+Fixed<FRACTION> abs(Fixed<FRACTION> value){
+	return value.raw() < 0 ? Fixed<FRACTION>::saturate(-(int64_t)value.raw()) : value;
+}
+
+template<int FRACTION>
+Fixed<FRACTION> fabs(Fixed<FRACTION> value){
+	return abs(value);
+}
+
+// sqrt: integer square root of the raw value scaled up by 2^FRACTION, 0 for negative values
+template<int FRACTION>
+Fixed<FRACTION> sqrt(Fixed<FRACTION> value){
+	if(value.raw() <= 0){
+		return Fixed<FRACTION>();
+	}
+	uint64_t remainder = (uint64_t)value.raw() << FRACTION;
+	uint64_t root = 0;
+	// Highest power of four not above remainder
+	uint64_t bit = (uint64_t)1 << ((63 - __builtin_clzll(remainder)) & ~1);
+	while(bit != 0){
+		if(remainder >= root + bit){
+			remainder -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return Fixed<FRACTION>::saturate((int64_t)root);
+}
+
+namespace std{
+	// numeric_limits: Fixed has no NaN, quiet_NaN returns zero so generic code stays well defined
+	template<int FRACTION>
+	class numeric_limits<Fixed<FRACTION> >{
+	public:
+		static const bool is_specialized = true;
+		static const bool is_signed = true;
+		static const bool is_integer = false;
+		static const bool is_exact = true;
+		static const bool has_quiet_NaN = false;
+		static constexpr Fixed<FRACTION> min(){
+			return Fixed<FRACTION>::fromRaw(1);
+		}
+		static constexpr Fixed<FRACTION> lowest(){
+			return Fixed<FRACTION>::fromRaw(Fixed<FRACTION>::RAW_MIN);
+		}
+		static constexpr Fixed<FRACTION> max(){
+			return Fixed<FRACTION>::fromRaw(Fixed<FRACTION>::RAW_MAX);
+		}
+		static constexpr Fixed<FRACTION> epsilon(){
+			return Fixed<FRACTION>::fromRaw(1);
+		}
+		static constexpr Fixed<FRACTION> quiet_NaN(){
+			return Fixed<FRACTION>();
+		}
+	};
+}
+
+// Fraction bits of Real in fixed-point builds: Q15.16 covers screen coordinates, ball velocities and
+// sensor distances to 1/65536
+const int REAL_FRACTION = 16;
+
+#ifdef FIXED_POINT
+typedef Fixed<REAL_FRACTION> Real;
+const char REAL_NAME[] = "fixed-q16";
+#else
+typedef float Real;
+const char REAL_NAME[] = "float";
+#endif
+
+// realRatio: numerator/denominator as Real, used for clock tick deltas so fixed-point builds never touch float
+Real realRatio(long numerator, long denominator){
+#ifdef FIXED_POINT
+	return Real::fromRatio(numerator, denominator);
+#else
+	return (float)numerator/denominator;
+#endif
+}
+
+// realToFloat: converts Real to float at boundaries that store float (flight recorder, logs)
+float realToFloat(Real value){
+	return (float)value;
+}
+
+// realToInt: truncates Real towards zero
+int realToInt(Real value){
+	return (int)value;
+}
+
+#endif // FIXED_H
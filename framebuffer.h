@@ -0,0 +1,181 @@
+/*///////////////////////////////////////
+// framebuffer.h: This file contains the
+// shared-memory frame publisher, the oled-exp
+// can't be read back over i2c so each frame
+// a DrawContext completes is copied into a
+// ring of slots in a memory-mapped file that
+// tools/pongView (and any other local reader)
+// maps read-only
+//
+// Every slot is guarded by a sequence lock:
+// the writer makes the sequence odd while it
+// copies and even when done, readers use a
+// frame in place and then check the sequence
+// didn't change, so the game never waits for
+// a reader and readers never copy
+*/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+namespace Framebuffer{
+
+	const char DEFAULT_PATH[] = "/tmp/motionpong.frames"; // tmpfs on the Omega like the stats file
+	const uint32_t FRAMES_MAGIC = 0x4D504642; // "MPFB"
+	const uint32_t FRAMES_VERSION = 1;
+	const int RING_SLOTS = 8;				// Frames kept per table, readers falling further behind skip frames
+	const int RINGS = 8;					// Tables that can publish, one ring each
+	const int MAX_FRAME_BYTES = 128*8;		// Largest frame, one byte per column of each page
+
+	// Slot: one published frame, sequence is odd while the writer is copying into it
+	struct Slot{
+		std::atomic<uint32_t> sequence;
+		uint32_t frame;							// Frame number within the ring
+		uint32_t micros;						// Metrics::nowMicros when the frame was published
+		uint8_t pixels[MAX_FRAME_BYTES];		// Frame in the oled-exp page layout, width bytes per page
+	};
+
+	// Ring: frames of one table, written by the table's render thread only
+	struct Ring{
+		std::atomic<uint32_t> published;		// Frames published, the newest is in slot (published - 1)%RING_SLOTS
+		Slot slots[RING_SLOTS];
+
+		// publish: copies size bytes of frame pixels into the next slot, never blocks
+		void publish(const uint8_t* pixels, int size, uint32_t micros){
+			uint32_t frame = published.load(std::memory_order_relaxed);
+			Slot& slot = slots[frame%RING_SLOTS];
+			uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+			slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.frame = frame;
+			slot.micros = micros;
+			memcpy(slot.pixels, pixels, size);
+			slot.sequence.store(sequence + 2, std::memory_order_release);
+			published.store(frame + 1, std::memory_order_release);
+		}
+	};
+
+	// Frames: layout of the frames file, only ever appended to (bump FRAMES_VERSION otherwise)
+	struct Frames{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t pid;							// Process publishing the frames
+		uint32_t width;							// Frame width in pixels
+		uint32_t pages;							// Frame height in pages of eight pixel rows
+		uint32_t rings;
+		Ring ring[RINGS];
+	};
+
+	// state: process local pointer to published frames, NULL while frames aren't published
+	struct State{
+		Frames* frames;
+	};
+
+	State& state(){
+		static State instance = {NULL};
+		return instance;
+	}
+
+	// unpublish: unmaps the frames file, rings handed out before must no longer be used
+	void unpublish(){
+		if(state().frames != NULL){
+			munmap(state().frames, sizeof(Frames));
+			state().frames = NULL;
+		}
+	}
+
+	// publish: maps frames file at path for frames width pixels wide and pages pages high, returns false with errno
+	// set if the file cannot be mapped or the frame doesn't fit a slot
+	bool publish(const char* path, int width, int pages){
+		if(width*pages > MAX_FRAME_BYTES){
+			errno = EINVAL;
+			return false;
+		}
+		int fd = open(path, O_RDWR | O_CREAT, 0644);
+		if(fd < 0){
+			return false;
+		}
+		if(ftruncate(fd, sizeof(Frames)) < 0){
+			close(fd);
+			return false;
+		}
+		void* memory = mmap(NULL, sizeof(Frames), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory == MAP_FAILED){
+			return false;
+		}
+		unpublish();
+		Frames* frames = new (memory) Frames();
+		frames->magic = FRAMES_MAGIC;
+		frames->version = FRAMES_VERSION;
+		frames->pid = (uint32_t)getpid();
+		frames->width = width;
+		frames->pages = pages;
+		frames->rings = RINGS;
+		state().frames = frames;
+		return true;
+	}
+
+	// ring: ring table publishes to, NULL if frames aren't published or table is out of range
+	Ring* ring(int table){
+		if(state().frames == NULL || table < 0 || table >= RINGS){
+			return NULL;
+		}
+		return &state().frames->ring[table];
+	}
+
+	// map: maps frames file at path read-only for readers, returns NULL if it is missing, from another version, truncated
+	// or describes frames that don't fit a slot
+	const Frames* map(const char* path = DEFAULT_PATH){
+		int fd = open(path, O_RDONLY);
+		if(fd < 0){
+			return NULL;
+		}
+		struct stat file;
+		if(fstat(fd, &file) < 0 || file.st_size < (off_t)sizeof(Frames)){
+			close(fd);
+			return NULL;
+		}
+		void* memory = mmap(NULL, sizeof(Frames), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory == MAP_FAILED){
+			return NULL;
+		}
+		const Frames* frames = (const Frames*)memory;
+		if(frames->magic != FRAMES_MAGIC || frames->version != FRAMES_VERSION || frames->width == 0 || frames->pages == 0 ||
+				frames->width > (uint32_t)MAX_FRAME_BYTES || frames->pages > (uint32_t)MAX_FRAME_BYTES/frames->width ||
+				frames->rings > (uint32_t)RINGS){
+			munmap(memory, sizeof(Frames));
+			return NULL;
+		}
+		return frames;
+	}
+
+	// latest: newest frame of ring to be used in place, NULL if none is published or it is being written, pass
+	// sequence to unchanged once done with the slot
+	const Slot* latest(const Ring& ring, uint32_t& sequence){
+		uint32_t published = ring.published.load(std::memory_order_acquire);
+		if(published == 0){
+			return NULL;
+		}
+		const Slot* slot = &ring.slots[(published - 1)%RING_SLOTS];
+		sequence = slot->sequence.load(std::memory_order_acquire);
+		if(sequence%2 != 0){
+			return NULL;
+		}
+		return slot;
+	}
+
+	// unchanged: true if slot wasn't rewritten since latest returned it, otherwise whatever was read from it is torn
+	bool unchanged(const Slot* slot, uint32_t sequence){
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot->sequence.load(std::memory_order_relaxed) == sequence;
+	}
+}
+
+#endif // FRAMEBUFFER_H
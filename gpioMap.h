@@ -0,0 +1,106 @@
+/*///////////////////////////////////////
+// gpioMap.h: This file contains the memory
+// mapped gpio fast path, ugpio reads a pin
+// through sysfs with a system call per sample
+// which limits how often an echo pin can be
+// polled, with the Omega 2's gpio registers
+// mapped a sample is a single load
+//
+// Map /dev/mem (root) or a device exposing the
+// gpio register page from offset 0 such as
+// /dev/gpiomem, on the host any file of at
+// least MAP_SIZE bytes stands in for the
+// registers (see pongBench --filter gpiomem_)
+*/
+
+#ifndef GPIO_MAP_H
+#define GPIO_MAP_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace GpioMap{
+
+	const off_t MEM_PAGE = 0x10000000;			// Physical page of the MT7688's (Omega 2) system registers in /dev/mem
+	const size_t MAP_SIZE = 4096;				// Bytes mapped, one page
+	const size_t DATA_OFFSET = 0x620;			// GPIO_DATA_0 within the page, GPIO_DATA_1 and 2 follow, bit n is pin 32*i + n
+	const int MAX_PINS = 96;					// Pins covered by the three data registers
+	const char* const DEV_MEM = "/dev/mem";
+
+	// Region: mapped register page, base is NULL while nothing is mapped
+	struct Region{
+		int fd;
+		volatile uint8_t* base;
+	};
+
+	Region& region(){
+		static Region instance = {-1, NULL};
+		return instance;
+	}
+
+	bool mapped(){
+		return region().base != NULL;
+	}
+
+	// unmap: unmaps the register page, sensors created while it was mapped must be freed first
+	void unmap(){
+		Region& mapping = region();
+		if(mapping.base != NULL){
+			munmap((void*)mapping.base, MAP_SIZE);
+			mapping.base = NULL;
+		}
+		if(mapping.fd >= 0){
+			close(mapping.fd);
+			mapping.fd = -1;
+		}
+	}
+
+	// map: maps the gpio register page read-only from path, /dev/mem is mapped at MEM_PAGE and anything else from
+	// offset 0, returns false with errno set on failure, sensors created afterwards poll their echo pins through it
+	bool map(const char* path){
+		unmap();
+		int fd = open(path, O_RDONLY | O_SYNC);
+		if(fd < 0){
+			return false;
+		}
+		off_t offset = strcmp(path, DEV_MEM) == 0 ? MEM_PAGE : 0;
+		void* base = mmap(NULL, MAP_SIZE, PROT_READ, MAP_SHARED, fd, offset);
+		if(base == MAP_FAILED){
+			int error = errno;
+			close(fd);
+			errno = error;
+			return false;
+		}
+		region().fd = fd;
+		region().base = (volatile uint8_t*)base;
+		return true;
+	}
+
+	// dataRegister: data register holding pin's value, NULL if nothing is mapped or pin is out of range
+	const volatile uint32_t* dataRegister(int pin){
+		if(!mapped() || pin < 0 || pin >= MAX_PINS){
+			return NULL;
+		}
+		return (const volatile uint32_t*)(region().base + DATA_OFFSET) + pin/32;
+	}
+
+	// pinMask: bit of pin in its data register
+	uint32_t pinMask(int pin){
+		return (uint32_t)1 << (pin%32);
+	}
+
+	// getValue: value of pin read from the mapped registers, -1 if it isn't mapped
+	int getValue(int pin){
+		const volatile uint32_t* data = dataRegister(pin);
+		if(data == NULL){
+			return -1;
+		}
+		return (*data & pinMask(pin)) != 0;
+	}
+}
+
+#endif // GPIO_MAP_H
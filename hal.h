@@ -0,0 +1,32 @@
+/*///////////////////////////////////////
+// hal.h: This file selects the hardware
+// abstraction layer backend at compile time,
+// every display and gpio access goes through
+// HAL::Display and HAL::Gpio so the game can
+// also be built for an x86 Linux host
+//
+// Backends are plain classes chosen with a
+// typedef so calls are direct and inlinable:
+// halOmega.h -> oled-exp and ugpio libraries (default)
+// halMock.h -> in-memory display and simulated
+//              HC-SR04 sensors, define HOST_MOCK
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef HOST_MOCK
+#include "halMock.h"
+#else
+#include "halOmega.h"
+#endif
+
+namespace HAL{
+	// display: returns display index, one per pong table, index must be below MAX_DISPLAYS
+	Display& display(int index = 0){
+		static Display instances[MAX_DISPLAYS];
+		return instances[index];
+	}
+}
+
+#endif // HAL_H
@@ -0,0 +1,336 @@
+/*///////////////////////////////////////
+// halMock.h: This file contains the host
+// backend of the hardware abstraction layer,
+// the display is an in-memory framebuffer and
+// each paired trigger/echo pin simulates an
+// HC-SR04 whose echo timing is a deterministic
+// function of Clock time (see clock.h), so
+// under a virtual clock the echoes follow it
+*/
+
+#ifndef HAL_MOCK_H
+#define HAL_MOCK_H
+
+#include "clock.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+namespace HAL{
+
+	// Display dimensions in pixels, the oled-exp's unless PANEL_WIDTH and PANEL_HEIGHT select another panel (make PANEL=WxH)
+#if defined(PANEL_WIDTH) && defined(PANEL_HEIGHT)
+	const int DISPLAY_WIDTH = PANEL_WIDTH;
+	const int DISPLAY_HEIGHT = PANEL_HEIGHT;
+#else
+	const int DISPLAY_WIDTH = 128;
+	const int DISPLAY_HEIGHT = 64;
+#endif
+
+	// Simulated displays, one per pong table
+	const int MAX_DISPLAYS = 8;
+
+	// Initial values for Gpio::directionOutput
+	const int GPIO_LOW = 0;
+	const int GPIO_HIGH = 1;
+
+	const int MOCK_CHAR_WIDTH = 6;					// Pixels per character
+	const int MOCK_TEXT_ROWS = DISPLAY_HEIGHT/8;	// Text rows, 8 on the oled-exp
+	const int MOCK_TEXT_COLUMNS = DISPLAY_WIDTH/MOCK_CHAR_WIDTH;	// Characters per text row, 21 on the oled-exp
+	const int MOCK_PINS = 64;						// Gpio pins simulated
+	const int MOCK_SENSORS = 20;					// Ultrasonic sensors simulated, two per table and the benchmark's
+	const float MOCK_SPEED_OF_SOUND = 343.0f;		// m/s
+	const int64_t MOCK_ECHO_DELAY = 450;			// Microseconds from trigger to echo rising, like an HC-SR04
+	const int64_t MOCK_NO_ECHO = 38000;				// Microseconds echo stays high when nothing is in range
+	const float MOCK_SWEEP_MIN = 0.05f;				// Default simulated hand sweeps between 5cm
+	const float MOCK_SWEEP_MAX = 0.40f;				// and 40cm
+	const int64_t MOCK_SWEEP_PERIOD = 4000000;		// Microseconds for one sweep back and forth
+	const float MOCK_NOISE = 0.002f;				// Deterministic noise of +-2mm added to each reading
+
+	// mockMicros: time of the simulated sensors in microseconds, the game's time source
+	int64_t mockMicros(){
+		return Clock::micros();
+	}
+
+	// class MockDisplay: in-memory oled, keeps a framebuffer in the oled-exp page layout and a grid of written text
+	class MockDisplay{
+	public:
+		MockDisplay(){
+			memset(mBuffer, 0, sizeof(mBuffer));
+			memset(mText, ' ', sizeof(mText));
+			for(int i = 0; i < MOCK_TEXT_ROWS; i++){
+				mText[i][MOCK_TEXT_COLUMNS] = '\0';
+			}
+			mRow = 0;
+			mColumn = 0;
+			mPowered = false;
+			mBytesWritten = 0;
+		}
+		int init(){
+			return EXIT_SUCCESS;
+		}
+		int setPower(int on){
+			mPowered = on != 0;
+			return EXIT_SUCCESS;
+		}
+		int setCursor(int row, int column){
+			if(row < 0 || row >= MOCK_TEXT_ROWS || column < 0 || column >= MOCK_TEXT_COLUMNS){
+				return EXIT_FAILURE;
+			}
+			mRow = row;
+			mColumn = column*MOCK_CHAR_WIDTH;
+			return EXIT_SUCCESS;
+		}
+		int setCursorByPixel(int row, int pixel){
+			if(row < 0 || row >= DISPLAY_HEIGHT/8 || pixel < 0 || pixel >= DISPLAY_WIDTH){
+				return EXIT_FAILURE;
+			}
+			mRow = row;
+			mColumn = pixel;
+			return EXIT_SUCCESS;
+		}
+		// writeByte: writes eight vertical pixels at the cursor and advances it like the oled's horizontal addressing mode
+		int writeByte(uint8_t byte){
+			mBuffer[mRow*DISPLAY_WIDTH + mColumn] = byte;
+			mBytesWritten++;
+			advance(1);
+			return EXIT_SUCCESS;
+		}
+		int writeChar(char c){
+			mText[mRow][mColumn/MOCK_CHAR_WIDTH] = c;
+			advance(MOCK_CHAR_WIDTH);
+			return EXIT_SUCCESS;
+		}
+		int write(const char* text){
+			while(*text != '\0'){
+				writeChar(*text++);
+			}
+			return EXIT_SUCCESS;
+		}
+		int draw(uint8_t* buffer, int size){
+			if(size > (int)sizeof(mBuffer)){
+				return EXIT_FAILURE;
+			}
+			memcpy(mBuffer, buffer, size);
+			mBytesWritten += size;
+			return EXIT_SUCCESS;
+		}
+
+		// pixel: returns true if pixel (x, y) is lit
+		bool pixel(int x, int y) const{
+			return (mBuffer[(y/8)*DISPLAY_WIDTH + x] >> (y%8)) & 1;
+		}
+		// buffer: framebuffer in oled-exp page layout
+		const uint8_t* buffer() const{
+			return mBuffer;
+		}
+		// text: characters written to text row
+		const char* text(int row) const{
+			return mText[row];
+		}
+		// bytesWritten: bytes written since construction
+		unsigned long bytesWritten() const{
+			return mBytesWritten;
+		}
+		bool powered() const{
+			return mPowered;
+		}
+
+	private:
+		// advance: moves cursor right wrapping to the next row
+		void advance(int pixels){
+			mColumn += pixels;
+			if(mColumn >= DISPLAY_WIDTH){
+				mColumn = 0;
+				mRow = (mRow + 1)%(DISPLAY_HEIGHT/8);
+			}
+		}
+
+		uint8_t mBuffer[DISPLAY_WIDTH*DISPLAY_HEIGHT/8];				// Framebuffer
+		char mText[MOCK_TEXT_ROWS][MOCK_TEXT_COLUMNS + 1];				// Text written with writeChar
+		int mRow;														// Cursor page row
+		int mColumn;													// Cursor pixel column
+		bool mPowered;													// Display power
+		unsigned long mBytesWritten;									// Bytes written with writeByte or draw
+	};
+
+	// MockSensor: simulated HC-SR04, echo window is set when the trigger pulse ends
+	struct MockSensor{
+		int trigger;
+		int echo;
+		std::atomic<int64_t> triggerHigh;	// Time trigger went high
+		std::atomic<int64_t> echoStart;		// Time echo goes high
+		std::atomic<int64_t> echoEnd;		// Time echo goes low
+		std::atomic<float> distance;		// Fixed distance in metres, NaN follows the default sweep, infinity gives no echo
+		uint32_t noise;						// Noise generator state
+	};
+
+	// MockGpioState: all simulated pins and sensors
+	struct MockGpioState{
+		MockGpioState() : sensorCount(0) {
+			memset(requested, 0, sizeof(requested));
+			memset(output, 0, sizeof(output));
+			memset(value, 0, sizeof(value));
+			for(int i = 0; i < MOCK_PINS; i++){
+				sensorOfPin[i] = -1;
+			}
+		}
+		bool requested[MOCK_PINS];
+		bool output[MOCK_PINS];
+		int value[MOCK_PINS];
+		int sensorOfPin[MOCK_PINS];			// Sensor index of a trigger or echo pin, -1 if none
+		MockSensor sensors[MOCK_SENSORS];
+		std::atomic<int> sensorCount;
+	};
+
+	// struct MockGpio: simulated pins, returns negative values on failure like ugpio
+	struct MockGpio{
+		// state: simulated pins, created on first use which may happen on several sensor threads at once
+		static MockGpioState& state(){
+			static MockGpioState instance;
+			return instance;
+		}
+
+		static int isRequested(int pin){
+			if(!valid(pin)){
+				return -1;
+			}
+			return state().requested[pin] ? 1 : 0;
+		}
+		static int request(int pin){
+			if(!valid(pin) || state().requested[pin]){
+				return -1;
+			}
+			state().requested[pin] = true;
+			return 0;
+		}
+		static int free(int pin){
+			if(!valid(pin)){
+				return -1;
+			}
+			state().requested[pin] = false;
+			return 0;
+		}
+		static int directionInput(int pin){
+			if(!valid(pin)){
+				return -1;
+			}
+			state().output[pin] = false;
+			return 0;
+		}
+		static int directionOutput(int pin, int value){
+			if(!valid(pin)){
+				return -1;
+			}
+			state().output[pin] = true;
+			return setValue(pin, value);
+		}
+		static int getValue(int pin){
+			if(!valid(pin)){
+				return -1;
+			}
+			MockGpioState& gpio = state();
+			int index = gpio.sensorOfPin[pin];
+			if(gpio.output[pin] || index < 0 || gpio.sensors[index].echo != pin){
+				return gpio.value[pin];
+			}
+			MockSensor& sensor = gpio.sensors[index];
+			int64_t now = mockMicros();
+			return now >= sensor.echoStart.load(std::memory_order_acquire) && now < sensor.echoEnd.load(std::memory_order_acquire) ? 1 : 0;
+		}
+		static int setValue(int pin, int value){
+			if(!valid(pin)){
+				return -1;
+			}
+			MockGpioState& gpio = state();
+			int previous = gpio.value[pin];
+			gpio.value[pin] = value != 0 ? 1 : 0;
+			int index = gpio.sensorOfPin[pin];
+			if(index >= 0 && gpio.sensors[index].trigger == pin){
+				if(previous == 0 && value != 0){
+					gpio.sensors[index].triggerHigh.store(mockMicros());
+				}
+				else if(previous != 0 && value == 0){
+					fire(gpio.sensors[index], index);
+				}
+			}
+			return 0;
+		}
+		// pairSensor: simulates an HC-SR04 wired to trigger and echo
+		static void pairSensor(int trigger, int echo){
+			if(!valid(trigger) || !valid(echo)){
+				return;
+			}
+			MockGpioState& gpio = state();
+			if(gpio.sensorOfPin[echo] >= 0){
+				return;
+			}
+			int index = gpio.sensorCount.load();
+			if(index >= MOCK_SENSORS){
+				return;
+			}
+			MockSensor& sensor = gpio.sensors[index];
+			sensor.trigger = trigger;
+			sensor.echo = echo;
+			sensor.echoStart.store(0);
+			sensor.echoEnd.store(0);
+			sensor.distance.store(std::numeric_limits<float>::quiet_NaN());
+			sensor.noise = 12345 + index;
+			gpio.sensorOfPin[trigger] = index;
+			gpio.sensorOfPin[echo] = index;
+			gpio.sensorCount.store(index + 1);
+		}
+
+		// setDistance: fixes distance seen by sensor with echo pin in metres, NaN returns to the default sweep
+		// and infinity simulates nothing in range
+		static void setDistance(int echo, float distance){
+			if(valid(echo) && state().sensorOfPin[echo] >= 0){
+				state().sensors[state().sensorOfPin[echo]].distance.store(distance);
+			}
+		}
+
+		// sweepDistance: default simulated hand position, a triangle wave offset by an eighth of a period for each sensor
+		static float sweepDistance(int index, int64_t now){
+			int64_t phase = (now + index*MOCK_SWEEP_PERIOD/8)%MOCK_SWEEP_PERIOD;
+			float position = (float)phase/(MOCK_SWEEP_PERIOD/2);
+			if(position > 1.0f){
+				position = 2.0f - position;
+			}
+			return MOCK_SWEEP_MIN + position*(MOCK_SWEEP_MAX - MOCK_SWEEP_MIN);
+		}
+
+	private:
+		static bool valid(int pin){
+			return pin >= 0 && pin < MOCK_PINS;
+		}
+
+		// fire: sets echo window for a completed trigger pulse
+		static void fire(MockSensor& sensor, int index){
+			int64_t now = mockMicros();
+			float distance = sensor.distance.load();
+			if(distance != distance){
+				distance = sweepDistance(index, now);
+			}
+			int64_t width;
+			if(distance == std::numeric_limits<float>::infinity()){
+				width = MOCK_NO_ECHO;
+			}
+			else{
+				sensor.noise = sensor.noise*1103515245u + 12345u;
+				float noise = ((int)((sensor.noise >> 16)%201) - 100)/100.0f*MOCK_NOISE;
+				width = (int64_t)((2.0f*(distance + noise)/MOCK_SPEED_OF_SOUND)*1000000.0f);
+			}
+			sensor.echoStart.store(now + MOCK_ECHO_DELAY, std::memory_order_release);
+			sensor.echoEnd.store(now + MOCK_ECHO_DELAY + width, std::memory_order_release);
+		}
+	};
+
+	typedef MockDisplay Display;
+	typedef MockGpio Gpio;
+}
+
+#endif // HAL_MOCK_H
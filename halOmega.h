@@ -0,0 +1,94 @@
+/*///////////////////////////////////////
+// halOmega.h: This file contains the Onion
+// Omega 2 backend of the hardware abstraction
+// layer, each method forwards to the oled-exp
+// or ugpio library
+*/
+
+#ifndef HAL_OMEGA_H
+#define HAL_OMEGA_H
+
+#include <stdint.h>
+
+#include <oled-exp.h>
+#include <ugpio/ugpio.h>
+
+#if defined(PANEL_WIDTH) || defined(PANEL_HEIGHT)
+#error "the oled-exp is 128x64, PANEL selects other panel geometries for HOST builds only"
+#endif
+
+namespace HAL{
+
+	// Display dimensions in pixels
+	const int DISPLAY_WIDTH = OLED_EXP_WIDTH;
+	const int DISPLAY_HEIGHT = OLED_EXP_HEIGHT;
+
+	// Displays a process can drive, the oled-exp sits at a fixed i2c address so there is one per board
+	const int MAX_DISPLAYS = 1;
+
+	// Initial values for Gpio::directionOutput
+	const int GPIO_LOW = GPIOF_INIT_LOW;
+	const int GPIO_HIGH = GPIOF_INIT_HIGH;
+
+	// class OmegaDisplay: oled-exp display, returns EXIT_SUCCESS or EXIT_FAILURE like the library
+	class OmegaDisplay{
+	public:
+		int init(){
+			return oledDriverInit();
+		}
+		int setPower(int on){
+			return oledSetDisplayPower(on);
+		}
+		int setCursor(int row, int column){
+			return oledSetCursor(row, column);
+		}
+		int setCursorByPixel(int row, int pixel){
+			return oledSetCursorByPixel(row, pixel);
+		}
+		int writeByte(uint8_t byte){
+			return oledWriteByte(byte);
+		}
+		int writeChar(char c){
+			return oledWriteChar(c);
+		}
+		int write(const char* text){
+			return oledWrite((char*)text);
+		}
+		int draw(uint8_t* buffer, int size){
+			return oledDraw(buffer, size);
+		}
+	};
+
+	// struct OmegaGpio: ugpio pins, returns negative values on failure like the library
+	struct OmegaGpio{
+		static int isRequested(int pin){
+			return gpio_is_requested(pin);
+		}
+		static int request(int pin){
+			return gpio_request(pin, NULL);
+		}
+		static int free(int pin){
+			return gpio_free(pin);
+		}
+		static int directionInput(int pin){
+			return gpio_direction_input(pin);
+		}
+		static int directionOutput(int pin, int value){
+			return gpio_direction_output(pin, value);
+		}
+		static int getValue(int pin){
+			return gpio_get_value(pin);
+		}
+		static int setValue(int pin, int value){
+			return gpio_set_value(pin, value);
+		}
+		// pairSensor: tells the backend trigger and echo belong to one ultrasonic sensor, nothing to do on hardware
+		static void pairSensor(int trigger, int echo){
+		}
+	};
+
+	typedef OmegaDisplay Display;
+	typedef OmegaGpio Gpio;
+}
+
+#endif // HAL_OMEGA_H
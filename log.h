@@ -1,6 +1,17 @@
 /*///////////////////////////////////////
 // log.h: This file contains methods for
 // logging to the file: runtime.log
+// records are formatted by the caller and
+// queued in a lock-free ring buffer, a
+// background thread writes them out in
+// batches so logging never blocks on I/O
+//
+// Hot paths use the LOG_ERROR/LOG_WARNING/
+// LOG_MESSAGE/LOG_DEBUG macros which compile
+// out below LOG_LEVEL and otherwise queue a
+// binary record (format ID and raw arguments)
+// to runtime.blog, see logformats.h and
+// tools/logDecode
 */
 
 #ifndef LOG_H
@@ -16,9 +27,18 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstdlib>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <type_traits>
 
-#include <oled-exp.h>
-#include <ugpio/ugpio.h>
+#include "logformats.h"
+#include "realtime.h"
+
+#include "hal.h"
 
 #ifdef DEBUG
 #define DEBUG_POINT std::cout << "[DEBUG POINT] in function: " << __func__ << " in file: " << __FILE__ << " on line: " << __LINE__ << std::endl
@@ -26,53 +46,447 @@
 #define DEBUG_POINT
 #endif
 
+// LOG_CHECK_LEVEL: fails to compile if format id is logged at another level than the one in LOG_FORMATS
+#define LOG_CHECK_LEVEL(id, level) static_assert(LOG::FORMAT_LEVELS[LOG::FORMAT_##id] == level, "log level differs from LOG_FORMATS for " #id)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(id, ...) do{ LOG_CHECK_LEVEL(id, LOG_LEVEL_ERROR); LOG::record(LOG::FORMAT_##id, LOG_LEVEL_ERROR, ##__VA_ARGS__); }while(0)
+#else
+#define LOG_ERROR(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define LOG_WARNING(id, ...) do{ LOG_CHECK_LEVEL(id, LOG_LEVEL_WARNING); LOG::record(LOG::FORMAT_##id, LOG_LEVEL_WARNING, ##__VA_ARGS__); }while(0)
+#else
+#define LOG_WARNING(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_MESSAGE
+#define LOG_MESSAGE(id, ...) do{ LOG_CHECK_LEVEL(id, LOG_LEVEL_MESSAGE); LOG::record(LOG::FORMAT_##id, LOG_LEVEL_MESSAGE, ##__VA_ARGS__); }while(0)
+#else
+#define LOG_MESSAGE(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(id, ...) do{ LOG_CHECK_LEVEL(id, LOG_LEVEL_DEBUG); LOG::record(LOG::FORMAT_##id, LOG_LEVEL_DEBUG, ##__VA_ARGS__); }while(0)
+#else
+#define LOG_DEBUG(id, ...) ((void)0)
+#endif
+
 namespace LOG{
 	const char file[] = "runtime.log";
-	
-	// writeLine: writes line to log file if timestamp is true a timestamp is prepended to line
-	void writeLine(std::string line, bool timestamp = true){
-		if(timestamp){
-			char stamp[100];
-			time_t t = time(0);
-    		struct tm * now = localtime(&t);
-    		strftime(stamp, 100, "%T", now);
-			line = std::string("(") + stamp + ")" + line;
-		}
-		
-		std::ofstream outfile;
-		outfile.open(LOG::file, std::ios::ate | std::ios_base::app);
-		if(!outfile.is_open()){
-			std::cerr << "[Warning]: failed to write line: \n" << line.data() << "\nTo log file: " << file << std::endl;
-			return;
+	const char binaryFile[] = "runtime.blog";
+
+	const int RECORD_SIZE = 256;		// Maximum length of one record including timestamp, longer lines are truncated
+	const int QUEUE_SIZE = 256;			// Number of records in ring buffer, must be a power of two
+	const int BATCH_SIZE = 8192;		// Size of each output batch written with one write call
+	const std::chrono::milliseconds FLUSH_INTERVAL = std::chrono::milliseconds(20); // Time writer thread sleeps when ring buffer is empty
+
+	// Output targets of a record
+	enum Target{
+		TARGET_FILE = 1,
+		TARGET_STDOUT = 2,
+		TARGET_STDERR = 4,
+		TARGET_BINARY = 8	// Record text is a binary record for runtime.blog
+	};
+
+	// Record: one pre-formatted line in the ring buffer, console output skips the timestamp
+	struct Record{
+		std::atomic<size_t> sequence;	// Ring buffer slot sequence, see RingBuffer
+		uint8_t targets;				// Bitwise OR of Target
+		uint16_t consoleOffset;			// Start of text written to stdout/stderr
+		uint16_t length;				// Length of text
+		char text[RECORD_SIZE];			// Line including trailing newline
+	};
+
+	// class RingBuffer: bounded multi-producer single-consumer queue of records, push never blocks
+	// and fails when the buffer is full
+	class RingBuffer{
+	public:
+		RingBuffer(){
+			for(int i = 0; i < QUEUE_SIZE; i++){
+				mRecords[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			mEnqueue.store(0, std::memory_order_relaxed);
+			mDequeue = 0;
+		}
+
+		// claim: reserves the next slot for a producer, returns NULL if buffer is full
+		Record* claim(size_t& position){
+			position = mEnqueue.load(std::memory_order_relaxed);
+			while(true){
+				Record* record = &mRecords[position & (QUEUE_SIZE - 1)];
+				size_t sequence = record->sequence.load(std::memory_order_acquire);
+				intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+				if(difference == 0){
+					if(mEnqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+						return record;
+					}
+				}
+				else if(difference < 0){
+					return NULL;
+				}
+				else{
+					position = mEnqueue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// commit: publishes a claimed slot to the consumer
+		void commit(Record* record, size_t position){
+			record->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		// push: claims a slot and copies prefix and line into it, returns false if buffer is full
+		bool push(uint8_t targets, const char* stamp, const char* prefix, const char* line){
+			size_t position;
+			Record* record = claim(position);
+			if(record == NULL){
+				return false;
+			}
+			int length = 0;
+			length = append(record->text, length, stamp);
+			record->consoleOffset = (uint16_t)length;
+			length = append(record->text, length, prefix);
+			length = append(record->text, length, line);
+			record->text[length++] = '\n';
+			record->length = (uint16_t)length;
+			record->targets = targets;
+			commit(record, position);
+			return true;
+		}
+
+		// front: returns oldest record or NULL if buffer is empty, must only be called by the consumer
+		Record* front(){
+			Record* record = &mRecords[mDequeue & (QUEUE_SIZE - 1)];
+			if(record->sequence.load(std::memory_order_acquire) != mDequeue + 1){
+				return NULL;
+			}
+			return record;
+		}
+
+		// pop: releases record returned by front back to producers
+		void pop(){
+			mRecords[mDequeue & (QUEUE_SIZE - 1)].sequence.store(mDequeue + QUEUE_SIZE, std::memory_order_release);
+			mDequeue++;
+		}
+
+		// enqueued: number of slots claimed by producers so far
+		size_t enqueued(){
+			return mEnqueue.load(std::memory_order_acquire);
+		}
+
+	private:
+		// append: copies string into text at length truncating at RECORD_SIZE - 1 (leaving room for newline)
+		static int append(char* text, int length, const char* string){
+			while(*string != '\0' && length < RECORD_SIZE - 1){
+				text[length++] = *string++;
+			}
+			return length;
+		}
+
+		Record mRecords[QUEUE_SIZE];		// Record slots
+		std::atomic<size_t> mEnqueue;		// Next slot producers claim
+		size_t mDequeue;					// Next slot consumer reads
+	};
+
+	// class Logger: owns the ring buffer, the log file descriptor and the writer thread
+	class Logger{
+	public:
+		Logger(){
+			mDropped.store(0);
+			mReported = 0;
+			mWritten.store(0);
+			mFileLength = 0;
+			mStdoutLength = 0;
+			mStderrLength = 0;
+			mStart = std::chrono::steady_clock::now();
+			mFd = open(LOG::file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+			if(mFd < 0){
+				std::cerr << "[Warning]: failed to open log file: " << LOG::file << ": " << strerror(errno) << std::endl;
+			}
+			mBinaryFd = open(LOG::binaryFile, O_WRONLY | O_CREAT | O_APPEND, 0644);
+			if(mBinaryFd < 0){
+				std::cerr << "[Warning]: failed to open log file: " << LOG::binaryFile << ": " << strerror(errno) << std::endl;
+			}
+			writeSession();
+			mStopped.store(false);
+			mRunning.store(true);
+			mThread = std::thread(&Logger::run, this);
+		}
+
+		// write: queues line for targets, drops line if ring buffer is full
+		void write(uint8_t targets, const char* prefix, const std::string& line, bool timestamp){
+			char stamp[16] = "";
+			if(timestamp){
+				char clock[12];
+				time_t t = time(0);
+				struct tm now;
+				localtime_r(&t, &now);
+				strftime(clock, sizeof(clock), "%T", &now);
+				snprintf(stamp, sizeof(stamp), "(%s)", clock);
+			}
+			if(!mBuffer.push(targets, stamp, prefix, line.data())){
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			if(mStopped.load(std::memory_order_acquire)){
+				// Writer thread has been joined: write out on caller's thread
+				std::lock_guard<std::mutex> lock(mLateMutex);
+				drain();
+			}
+		}
+
+		// claimBinary: claims a slot for a binary record, returns NULL and counts a drop if buffer is full
+		Record* claimBinary(size_t& position){
+			Record* record = mBuffer.claim(position);
+			if(record == NULL){
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			return record;
+		}
+
+		// commitBinary: publishes binary record of length bytes
+		void commitBinary(Record* record, size_t position, int length){
+			record->targets = TARGET_BINARY;
+			record->consoleOffset = 0;
+			record->length = (uint16_t)length;
+			mBuffer.commit(record, position);
+			if(mStopped.load(std::memory_order_acquire)){
+				std::lock_guard<std::mutex> lock(mLateMutex);
+				drain();
+			}
+		}
+
+		// elapsedMillis: milliseconds since logger started, stored in binary records
+		uint32_t elapsedMillis(){
+			return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - mStart).count();
+		}
+
+		// flush: blocks until every record queued before the call has been written
+		void flush(){
+			size_t target = mBuffer.enqueued();
+			while(mWritten.load(std::memory_order_acquire) < target && mRunning.load(std::memory_order_acquire)){
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		// stop: stops writer thread after writing remaining records
+		void stop(){
+			if(mRunning.exchange(false)){
+				mThread.join();
+				// Records queued while the writer was finishing are written here, later ones by their producer
+				std::lock_guard<std::mutex> lock(mLateMutex);
+				mStopped.store(true, std::memory_order_release);
+				drain();
+			}
+		}
+
+		// dropped: number of records dropped because the ring buffer was full
+		unsigned long dropped(){
+			return mDropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// run: writer thread, drains ring buffer and sleeps while it is empty
+		void run(){
+			Realtime::apply(Realtime::ROLE_LOG);
+			while(mRunning.load(std::memory_order_acquire)){
+				if(drain() == 0){
+					std::this_thread::sleep_for(FLUSH_INTERVAL);
+				}
+			}
+		}
+
+		// drain: writes all queued records in batches, returns number of records written
+		int drain(){
+			int count = 0;
+			Record* record;
+			while((record = mBuffer.front()) != NULL){
+				if(record->targets & TARGET_FILE){
+					batch(mFd, mFileBatch, mFileLength, record->text, record->length);
+				}
+				if(record->targets & TARGET_STDOUT){
+					batch(STDOUT_FILENO, mStdoutBatch, mStdoutLength, record->text + record->consoleOffset, record->length - record->consoleOffset);
+				}
+				if(record->targets & TARGET_STDERR){
+					batch(STDERR_FILENO, mStderrBatch, mStderrLength, record->text + record->consoleOffset, record->length - record->consoleOffset);
+				}
+				if(record->targets & TARGET_BINARY){
+					batch(mBinaryFd, mBinaryBatch, mBinaryLength, record->text, record->length);
+				}
+				mBuffer.pop();
+				count++;
+			}
+			unsigned long dropped = mDropped.load(std::memory_order_relaxed);
+			if(dropped != mReported){
+				char line[96];
+				int length = snprintf(line, sizeof(line), "[LOG][WARNING]: dropped %lu log records, ring buffer was full\n", dropped - mReported);
+				batch(mFd, mFileBatch, mFileLength, line, length);
+				batch(STDERR_FILENO, mStderrBatch, mStderrLength, line, length);
+				mReported = dropped;
+			}
+			if(count > 0 || mFileLength > 0 || mStderrLength > 0){
+				writeAll(mBinaryFd, mBinaryBatch, mBinaryLength);
+				writeAll(mFd, mFileBatch, mFileLength);
+				writeAll(STDOUT_FILENO, mStdoutBatch, mStdoutLength);
+				writeAll(STDERR_FILENO, mStderrBatch, mStderrLength);
+				mWritten.fetch_add(count, std::memory_order_release);
+			}
+			return count;
 		}
-		else{
-			outfile << line + "\n";
+
+		// writeSession: writes session record so the decoder can convert record times to wall time
+		void writeSession(){
+			uint8_t session[RECORD_HEADER_SIZE + 3*RECORD_ARG_SIZE];
+			uint16_t id = FORMAT_SESSION;
+			int64_t args[3] = {SESSION_MAGIC, (int64_t)time(0), FORMAT_COUNT};
+			uint32_t millis = 0;
+			memcpy(session, &id, 2);
+			session[2] = 3;
+			session[3] = LOG_LEVEL;
+			memcpy(session + 4, &millis, 4);
+			memcpy(session + RECORD_HEADER_SIZE, args, sizeof(args));
+			int length = sizeof(session);
+			mBinaryLength = 0;
+			batch(mBinaryFd, mBinaryBatch, mBinaryLength, (const char*)session, length);
+			writeAll(mBinaryFd, mBinaryBatch, mBinaryLength);
+		}
+
+		// batch: appends text to batch buffer writing the buffer out first if text does not fit
+		static void batch(int fd, char* buffer, int& length, const char* text, int size){
+			if(length + size > BATCH_SIZE){
+				writeAll(fd, buffer, length);
+			}
+			memcpy(buffer + length, text, size);
+			length += size;
+		}
+
+		// writeAll: writes length bytes of buffer to fd and empties the buffer
+		static void writeAll(int fd, const char* buffer, int& length){
+			int offset = 0;
+			while(fd >= 0 && offset < length){
+				ssize_t written = ::write(fd, buffer + offset, length - offset);
+				if(written < 0){
+					if(errno == EINTR){
+						continue;
+					}
+					break;
+				}
+				offset += written;
+			}
+			length = 0;
+		}
+
+		RingBuffer mBuffer;							// Queued records
+		std::atomic<unsigned long> mDropped;		// Records dropped because buffer was full
+		unsigned long mReported;					// Dropped records already reported in log
+		std::atomic<size_t> mWritten;				// Records written so far
+		std::atomic<bool> mRunning;					// False once writer thread is asked to stop
+		std::atomic<bool> mStopped;					// True once writer thread has been joined, producers then drain themselves
+		std::mutex mLateMutex;						// Serialises writes after writer thread stopped
+		std::thread mThread;						// Writer thread
+		int mFd;									// Log file, opened once
+		int mBinaryFd;								// Binary log file, opened once
+		std::chrono::steady_clock::time_point mStart;	// Time logger started, binary record times are relative to it
+		char mBinaryBatch[BATCH_SIZE];				// Pending output for binary log file
+		int mBinaryLength;							// Length of mBinaryBatch
+		char mFileBatch[BATCH_SIZE];				// Pending output for log file
+		char mStdoutBatch[BATCH_SIZE];				// Pending output for stdout
+		char mStderrBatch[BATCH_SIZE];				// Pending output for stderr
+		int mFileLength;							// Length of mFileBatch
+		int mStdoutLength;							// Length of mStdoutBatch
+		int mStderrLength;							// Length of mStderrBatch
+	};
+
+	void shutdown();
+
+	// logger: returns process wide logger, started on first use and stopped at exit
+	Logger& logger(){
+		static Logger* instance = NULL;
+		static std::once_flag started;
+		std::call_once(started, [](){
+			instance = new Logger();
+			atexit(LOG::shutdown);
+		});
+		return *instance;
+	}
+
+	// shutdown: writes out remaining records and stops writer thread, later records are written synchronously
+	void shutdown(){
+		logger().stop();
+	}
+
+	// flush: blocks until all queued records have been written
+	void flush(){
+		logger().flush();
+	}
+
+	// droppedRecords: returns number of records dropped because the ring buffer was full
+	unsigned long droppedRecords(){
+		return logger().dropped();
+	}
+
+	// packValue: stores argument as a raw 8 byte double or int64
+	template<typename Arg>
+	void packValue(uint8_t* out, Arg arg, std::true_type){
+		double value = arg;
+		memcpy(out, &value, RECORD_ARG_SIZE);
+	}
+	template<typename Arg>
+	void packValue(uint8_t* out, Arg arg, std::false_type){
+		int64_t value = (int64_t)arg;
+		memcpy(out, &value, RECORD_ARG_SIZE);
+	}
+
+	// packArgs: stores each argument in consecutive 8 byte slots
+	void packArgs(uint8_t*){
+	}
+	template<typename Arg, typename... Rest>
+	void packArgs(uint8_t* out, Arg arg, Rest... rest){
+		packValue(out, arg, typename std::is_floating_point<Arg>::type());
+		packArgs(out + RECORD_ARG_SIZE, rest...);
+	}
+
+	// record: queues binary record of format id with raw arguments, use the LOG_* macros so disabled levels compile out
+	template<typename... Args>
+	void record(FormatId id, uint8_t level, Args... args){
+		static_assert(sizeof...(Args) <= MAX_ARGS, "too many arguments for binary log record");
+		Logger& log = logger();
+		size_t position;
+		Record* record = log.claimBinary(position);
+		if(record == NULL){
+			return;
 		}
-		outfile.close();
+		uint8_t* out = (uint8_t*)record->text;
+		uint16_t format = (uint16_t)id;
+		uint32_t millis = log.elapsedMillis();
+		memcpy(out, &format, 2);
+		out[2] = (uint8_t)sizeof...(Args);
+		out[3] = level;
+		memcpy(out + 4, &millis, 4);
+		packArgs(out + RECORD_HEADER_SIZE, args...);
+		log.commitBinary(record, position, RECORD_HEADER_SIZE + RECORD_ARG_SIZE*sizeof...(Args));
+	}
+
+	// writeLine: writes line to log file if timestamp is true a timestamp is prepended to line
+	void writeLine(std::string line, bool timestamp = true){
+		logger().write(TARGET_FILE, "", line, timestamp);
 	}
-	
+
 	// message: writes message to log file
 	void message(std::string msg){
-		std::cout << "[MESSAGE]: " << msg << std::endl;
-		std::string finalMsg = std::string("[MESSAGE]: ") + msg;
-		writeLine(finalMsg);
+		logger().write(TARGET_FILE | TARGET_STDOUT, "[MESSAGE]: ", msg, true);
 	}
-	
-	// error: writes error to log file
-	std::string error(std::string err){ // returns error string
+
+	// error: writes error to log file and screen, errors are fatal so the log is flushed before returning
+	std::string error(std::string err, HAL::Display& screen = HAL::display()){ // returns error string
 		std::string display = std::string("[FATAL ERROR]: ") + err;
-		oledWrite((char*)display.data());
-		std::cerr << "[LOG][ERROR]: " << err << std::endl;
-		std::string finalErr = std::string("[LOG][ERROR]: ") + err;
-		writeLine(finalErr);
+		screen.write(display.c_str());
+		logger().write(TARGET_FILE | TARGET_STDERR, "[LOG][ERROR]: ", err, true);
+		logger().flush();
 		return display;
 	}
-	
+
 	// warning: writes warning to log file
 	void warning(std::string warn){
-		std::cerr << "[LOG][WARNING]: " << warn << std::endl;
-		std::string finalWarn = std::string("[LOG][ERROR]: ") + warn;
-		writeLine(finalWarn);
+		logger().write(TARGET_FILE | TARGET_STDERR, "[LOG][WARNING]: ", warn, true);
 	}
 }
 #endif // LOG_H
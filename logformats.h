@@ -0,0 +1,71 @@
+/*///////////////////////////////////////
+// logformats.h: This file contains the table
+// of binary log record formats shared by the
+// game and tools/logDecode, records store a
+// format ID and raw arguments instead of text
+//
+// Only append to the table: IDs are positions
+// in the table and old logs are decoded with
+// the current table
+*/
+
+#ifndef LOGFORMATS_H
+#define LOGFORMATS_H
+
+// Log levels, messages above LOG_LEVEL are compiled out
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_MESSAGE 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_WARNING
+#endif
+
+// LOG_FORMATS: FORMAT(id, level, format) for each binary record, the LOG_* macro used must match level, format arguments are
+// %d/%i/%u/%x for integers and %f/%g for floating point values
+#define LOG_FORMATS(FORMAT) \
+	FORMAT(IMAGE_XOR_NULL, LOG_LEVEL_WARNING, "invalid use of operator ^ on class Image: cannot perform bitwise XOR on null buffer") \
+	FORMAT(IMAGE_AND_NULL, LOG_LEVEL_WARNING, "invalid use of operator & on class Image: cannot perform bitwise AND on null buffer") \
+	FORMAT(WRITE_PIXEL_DELETED, LOG_LEVEL_WARNING, "failed to write pixel to image: buffer is deleted") \
+	FORMAT(WRITE_PIXEL_OUT_OF_BOUNDS, LOG_LEVEL_WARNING, "failed to write pixel to image: coordinates (%u, %u) out of bounds") \
+	FORMAT(WRITE_BYTE_OUT_OF_BOUNDS, LOG_LEVEL_WARNING, "failed to write byte to image: row %u column %u out of bounds") \
+	FORMAT(WRITE_RECT_FAILED, LOG_LEVEL_WARNING, "failed to write rect to image with coordinates: (%u, %u) and dimensions: %ux%u") \
+	FORMAT(CLEAR_DELETED, LOG_LEVEL_WARNING, "failed to clear image: buffer was deleted") \
+	FORMAT(UNDRAW_DELETED, LOG_LEVEL_WARNING, "failed to undraw image: buffer was deleted") \
+	FORMAT(DRAW_BYTES_DELETED, LOG_LEVEL_WARNING, "failed to draw image using raw bytes: buffer was deleted") \
+	FORMAT(CONTEXT_CLEAR_FAILED, LOG_LEVEL_WARNING, "failed to clear draw context: unDraw on clear buffer failed") \
+	FORMAT(CONTEXT_DRAW_FAILED, LOG_LEVEL_WARNING, "failed to draw context: drawBytes on current buffer failed") \
+	FORMAT(SENSOR_FREE_FAILED, LOG_LEVEL_WARNING, "failed to free sensor gpio's: trigger pin: %d echo pin: %d") \
+	FORMAT(SENSOR_TRIGGER_FAILED, LOG_LEVEL_WARNING, "failed to trigger ultrasonic sensor with trigger pin: %d and echo pin: %d with status: %d") \
+	FORMAT(SENSOR_TIMEOUT, LOG_LEVEL_DEBUG, "ultrasonic sensor with echo pin: %d timed out after %fs") \
+	FORMAT(UPDATE_FAILED, LOG_LEVEL_WARNING, "failed to update") \
+	FORMAT(DRAW_FAILED, LOG_LEVEL_WARNING, "failed to draw pong game") \
+	FORMAT(UDP_RECEIVE_FAILED, LOG_LEVEL_WARNING, "failed to receive from udp socket: errno %d") \
+	FORMAT(REALTIME_FAILED, LOG_LEVEL_WARNING, "failed to apply real-time profile to thread with role: %d: errno %d") \
+	FORMAT(WRITE_DIFFERENCE_NULL, LOG_LEVEL_WARNING, "failed to write difference of images: null buffer")
+
+namespace LOG{
+	#define LOG_FORMAT_ID(id, level, format) FORMAT_##id,
+	enum FormatId{
+		LOG_FORMATS(LOG_FORMAT_ID)
+		FORMAT_COUNT
+	};
+	#undef LOG_FORMAT_ID
+
+	// FORMAT_LEVELS: level of each format, the LOG_* macros check they are used at it
+	#define LOG_FORMAT_LEVEL(id, level, format) level,
+	constexpr unsigned char FORMAT_LEVELS[] = {
+		LOG_FORMATS(LOG_FORMAT_LEVEL)
+	};
+	#undef LOG_FORMAT_LEVEL
+
+	const unsigned short FORMAT_SESSION = 0xFFFF;	// ID of record starting each run: arguments are magic, wall time and FORMAT_COUNT
+	const unsigned int SESSION_MAGIC = 0x4D504C47;	// "MPLG"
+	const int MAX_ARGS = 8;							// Maximum arguments in one record
+	const int RECORD_HEADER_SIZE = 8;				// id(2) argument count(1) level(1) milliseconds since session start(4)
+	const int RECORD_ARG_SIZE = 8;					// Each argument is an int64 or a double, in native (little-endian on the Omega) byte order
+}
+
+#endif // LOGFORMATS_H
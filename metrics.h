@@ -0,0 +1,243 @@
+/*///////////////////////////////////////
+// metrics.h: This file contains per-frame
+// instrumentation, each game phase is timed
+// into a fixed-size lock-free histogram that
+// lives in a memory-mapped stats file so
+// tools/pongStat can read it while the game
+// is running
+//
+// Define NO_METRICS to compile timing out
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Metrics{
+
+	const char DEFAULT_PATH[] = "/tmp/motionpong.stats"; // tmpfs on the Omega so publishing never touches flash
+	const uint32_t STATS_MAGIC = 0x4D505354; // "MPST"
+	const uint32_t STATS_VERSION = 2;
+	const int HISTOGRAM_BUCKETS = 32; // Bucket 0 counts zero, bucket i counts values in [2^(i-1), 2^i)
+
+	// Timed phases of the game loop
+	enum Phase{
+		PHASE_FRAME,			// Whole frame: update and draw
+		PHASE_UPDATE,			// MotionPong::update
+		PHASE_RASTER,			// Writing paddles and ball into the draw context
+		PHASE_CLEAR,			// DrawContext::clear bus traffic
+		PHASE_DRAW,				// DrawContext::draw bus traffic
+		PHASE_SENSOR_WAIT,		// Waiting in Sensor::joinThreadedRead
+		PHASE_RESET,			// MotionPong::reset
+		PHASE_ROUND_WAIT,		// Time from a point being scored to the next serve
+		PHASE_COUNT
+	};
+
+	const char* const PHASE_NAMES[PHASE_COUNT] = {"frame", "update", "raster", "clear", "draw", "sensor-wait", "reset", "round-wait"};
+
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "stats file needs lock-free 32 bit atomics to be shared between processes");
+
+	// Histogram: counts of values (microseconds or bytes) in power of two buckets,
+	// 32 bit counters so updates stay lock-free on 32 bit MIPS
+	struct Histogram{
+		std::atomic<uint32_t> buckets[HISTOGRAM_BUCKETS];
+		std::atomic<uint32_t> count;
+		std::atomic<uint32_t> max;
+
+		// add: counts value, safe to call from any thread
+		void add(uint32_t value){
+			int bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+			if(bucket >= HISTOGRAM_BUCKETS){
+				bucket = HISTOGRAM_BUCKETS - 1;
+			}
+			buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			uint32_t previous = max.load(std::memory_order_relaxed);
+			while(value > previous && !max.compare_exchange_weak(previous, value, std::memory_order_relaxed)){
+			}
+		}
+
+		// percentile: returns upper bound of bucket holding the p'th percentile (at most max), 0 if empty
+		uint32_t percentile(float p) const{
+			uint32_t total = count.load(std::memory_order_relaxed);
+			if(total == 0){
+				return 0;
+			}
+			uint32_t rank = (uint32_t)(p/100.0f*total);
+			uint32_t seen = 0;
+			for(int i = 0; i < HISTOGRAM_BUCKETS; i++){
+				seen += buckets[i].load(std::memory_order_relaxed);
+				if(seen > rank){
+					uint32_t upper = i == 0 ? 0 : (uint32_t)((1ull << i) - 1);
+					uint32_t largest = max.load(std::memory_order_relaxed);
+					return upper < largest ? upper : largest;
+				}
+			}
+			return max.load(std::memory_order_relaxed);
+		}
+	};
+
+	// Stats: layout of the stats file, only ever appended to (bump STATS_VERSION otherwise), size lets readers
+	// built before a field was appended map files that have it
+	struct Stats{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size;							// sizeof(Stats) of the process publishing the stats
+		uint32_t pid;							// Process publishing the stats
+		uint32_t phaseCount;
+		Histogram phases[PHASE_COUNT];			// Phase durations in microseconds
+		Histogram frameBytes;					// Bytes written to the display each frame
+		std::atomic<uint32_t> frames;			// Frames drawn
+		std::atomic<uint32_t> sensorSamples;	// Individual sensor readings taken
+		std::atomic<uint32_t> sensorNaNs;		// Readings that timed out or failed
+		Histogram motionToPhoton;				// Microseconds from capturing a sensor sample to drawing the paddle move it caused
+	};
+
+	// state: process local pointer to published stats, falls back to static storage if the stats file is unavailable
+	struct State{
+		Stats* stats;
+	};
+
+	State& state(){
+		static Stats fallback;
+		static State instance = {&fallback};
+		return instance;
+	}
+
+	// currentFrameBytes: bytes written during the calling render thread's current frame, per thread so several
+	// tables can render at once
+	uint32_t& currentFrameBytes(){
+		static thread_local uint32_t bytes = 0;
+		return bytes;
+	}
+
+	Stats* stats(){
+		return state().stats;
+	}
+
+	// initStats: clears stats and writes header
+	void initStats(Stats* stats){
+		new (stats) Stats();
+		stats->magic = STATS_MAGIC;
+		stats->version = STATS_VERSION;
+		stats->size = sizeof(Stats);
+		stats->pid = (uint32_t)getpid();
+		stats->phaseCount = PHASE_COUNT;
+	}
+
+	// publish: maps stats file at path and records into it from now on, returns false (and keeps recording
+	// in process memory) if the file cannot be mapped
+	bool publish(const char* path = DEFAULT_PATH){
+		int fd = open(path, O_RDWR | O_CREAT, 0644);
+		if(fd < 0){
+			return false;
+		}
+		if(ftruncate(fd, sizeof(Stats)) < 0){
+			close(fd);
+			return false;
+		}
+		void* memory = mmap(NULL, sizeof(Stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory == MAP_FAILED){
+			return false;
+		}
+		Stats* stats = (Stats*)memory;
+		initStats(stats);
+		state().stats = stats;
+		return true;
+	}
+
+	// map: maps stats file at path read-only for readers, returns NULL if it is missing, from another version or
+	// smaller than the Stats this reader was built with
+	const Stats* map(const char* path = DEFAULT_PATH){
+		int fd = open(path, O_RDONLY);
+		if(fd < 0){
+			return NULL;
+		}
+		struct stat file;
+		if(fstat(fd, &file) < 0 || file.st_size < (off_t)sizeof(Stats)){
+			close(fd);
+			return NULL;
+		}
+		void* memory = mmap(NULL, sizeof(Stats), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(memory == MAP_FAILED){
+			return NULL;
+		}
+		const Stats* stats = (const Stats*)memory;
+		if(stats->magic != STATS_MAGIC || stats->version != STATS_VERSION || stats->size < sizeof(Stats)){
+			munmap(memory, sizeof(Stats));
+			return NULL;
+		}
+		return stats;
+	}
+
+	// nowMicros: monotonic clock in microseconds, wraps every 71 minutes which is fine for durations
+	uint32_t nowMicros(){
+		return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// record: adds duration in microseconds to phase
+	void record(Phase phase, uint32_t micros){
+		stats()->phases[phase].add(micros);
+	}
+
+	// addBytes: counts bytes written to the display this frame by the calling render thread
+	void addBytes(uint32_t bytes){
+		currentFrameBytes() += bytes;
+	}
+
+	// addSensorSamples: counts sensor readings and how many of them were NaN, safe from sensor threads
+	void addSensorSamples(uint32_t samples, uint32_t nans){
+		stats()->sensorSamples.fetch_add(samples, std::memory_order_relaxed);
+		stats()->sensorNaNs.fetch_add(nans, std::memory_order_relaxed);
+	}
+
+	// addMotionToPhoton: records latency from a sensor sample's capture time to the frame that first showed it
+	void addMotionToPhoton(uint32_t captured){
+		stats()->motionToPhoton.add(nowMicros() - captured);
+	}
+
+	// frameBytes: bytes written to the display so far this frame
+	uint32_t frameBytes(){
+		return currentFrameBytes();
+	}
+
+	// endFrame: publishes bytes written this frame and counts frame
+	void endFrame(){
+		stats()->frameBytes.add(currentFrameBytes());
+		stats()->frames.fetch_add(1, std::memory_order_relaxed);
+		currentFrameBytes() = 0;
+	}
+
+	// class ScopedPhase: records time from construction to destruction into phase
+	class ScopedPhase{
+	public:
+#ifndef NO_METRICS
+		ScopedPhase(Phase phase){
+			mPhase = phase;
+			mStart = nowMicros();
+		}
+		~ScopedPhase(){
+			record(mPhase, nowMicros() - mStart);
+		}
+	private:
+		Phase mPhase;		// Phase being timed
+		uint32_t mStart;	// Start time in microseconds
+#else
+		ScopedPhase(Phase phase){
+		}
+#endif
+	};
+}
+
+#endif // METRICS_H
@@ -0,0 +1,758 @@
+/*///////////////////////////////////////
+// motionPong.h: This file contains the pong
+// game: paddles, ball physics, the round state
+// machine and drawing, shared by motionPong.cpp
+// and the host benchmarks
+*/
+
+#ifndef MOTIONPONG_H
+#define MOTIONPONG_H
+
+#include "oled.h"
+#include "ultrasonic.h"
+#include "network.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "clock.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <cstdlib>
+
+enum Gamemode{
+	PLAYER_VS_PLAYER,
+	PLAYER_VS_CPU,
+	CPU_VS_CPU
+};
+
+// Round states: a round waits for players hands, counts down, serves the ball then plays until a point is scored
+enum RoundState{
+	ROUND_READY_CHECK,
+	ROUND_COUNTDOWN,
+	ROUND_SERVE,
+	ROUND_PLAYING
+};
+
+// Wall clock used for the startup times logged, game time (round transitions, physics) is read from Clock::micros
+typedef std::chrono::steady_clock WallClock;
+
+// parseGamemode: parses game-mode command line argument (pvp, pvc or cvc) into mode, returns false if unrecognised
+bool parseGamemode(const char* arg, Gamemode& mode){
+	std::string name(arg);
+	if(name == "pvp" || name == "player-vs-player"){
+		mode = PLAYER_VS_PLAYER;
+	}
+	else if(name == "pvc" || name == "player-vs-cpu"){
+		mode = PLAYER_VS_CPU;
+	}
+	else if(name == "cvc" || name == "cpu-vs-cpu"){
+		mode = CPU_VS_CPU;
+	}
+	else{
+		return false;
+	}
+	return true;
+}
+
+// Layout: game object sizes and text placement for a PANEL sized screen, the oled-exp's 128x64 gives 20x5 paddles,
+// a 4x4 ball, initial ball velocities within 40 pixels per second and messages on text row 3 of 21 columns
+template<typename PANEL>
+struct Layout{
+	static const int PADDLE_WIDTH = 16*PANEL::WIDTH/100;
+	static const int PADDLE_HEIGHT = 8*PANEL::HEIGHT/100;
+	static const int BALL_SIZE = PANEL::HEIGHT/16 > 2 ? PANEL::HEIGHT/16 : 2;
+	static const int BALL_RANGE_X = 40*PANEL::WIDTH/128;
+	static const int BALL_RANGE_Y = 40*PANEL::HEIGHT/64;
+	static const int TEXT_ROW = PANEL::ROWS/2 - 1;			// Text row of messages and scores, in the middle of the screen
+	static const int TEXT_COLUMNS = PANEL::WIDTH/6;			// Characters per text row of the six pixel wide font
+	static_assert(PADDLE_HEIGHT >= 1 && 2*PADDLE_HEIGHT + BALL_SIZE < PANEL::HEIGHT, "panel too small for pong");
+};
+
+typedef Layout<OLED::GamePanel> GameLayout;
+
+// Dimensions of pong paddles
+const vec2i PADDLE_DIM = vec2i(GameLayout::PADDLE_WIDTH, GameLayout::PADDLE_HEIGHT);
+// Ball dimensions
+const vec2i BALL_DIM = vec2i(GameLayout::BALL_SIZE, GameLayout::BALL_SIZE);
+// Range in initial ball velocities
+const vec2i BALL_RANGE = vec2i(GameLayout::BALL_RANGE_X, GameLayout::BALL_RANGE_Y);
+// Time players must hold their hands near the sensors before the countdown starts
+const std::chrono::seconds READY_HOLD_TIME = std::chrono::seconds(2);
+// Length of countdown before serve in seconds
+const int COUNTDOWN_SECONDS = 3;
+// Frame period while waiting between rounds, program sleeps for the remainder of each frame
+const std::chrono::milliseconds IDLE_FRAME_PERIOD = std::chrono::milliseconds(20);
+
+// PinMap: gpio pins of one table's sensors
+struct PinMap{
+	int trigger1;	// Player 1's sensor
+	int echo1;
+	int trigger2;	// Player 2's sensor
+	int echo2;
+};
+
+// Pins of a single table wired as in the report
+const PinMap DEFAULT_PINS = {US_ONE_TRIGGER, US_ONE_ECHO, US_TWO_TRIGGER, US_TWO_ECHO};
+
+// Echo running average is kept in 1/ECHO_AVERAGE_SCALE microseconds so the integer filter keeps the float filter's precision
+const int32_t ECHO_AVERAGE_SCALE = 16;
+
+// PongPaddle class contains all state for each pong paddle
+struct PongPaddle{
+	PongPaddle(){
+		lastMicros = 0;
+		currentMicros = Clock::micros();
+		position.x = (OLED::SCREEN_WIDTH/2) - PADDLE_DIM.x/2;
+		position.y = 0;
+		runningAverage = 0;
+		lastRunningAverage = 0;
+		for(int i = 0; i < 5; i++){
+			previousDistances[i] = 0;
+			previousEchoes[i] = 0;
+		}
+		echoAverage = 0;
+		lastEchoAverage = 0;
+		speed = 0.0;
+		remote = NULL;
+		remoteIndex = 0;
+		lastEcho = 0;
+		lastCaptured = 0;
+		movePending = false;
+	}
+	Ultrasonic::Sensor sensor;		// Ultrasonic sensor for paddle
+	Network::PaddleReceiver* remote;	// Remote paddle input, NULL if paddle is read from its ultrasonic sensor
+	int remoteIndex;				// Paddle index in remote packets
+	vec2r position;					// Position vector of paddle
+	Real lastRunningAverage;		// Last frame's running average
+	int64_t lastMicros;				// Clock time of the previous sample in microseconds
+	int64_t currentMicros;			// Clock time of the current sample in microseconds
+	Real runningAverage;			// Current running average of sensor distance, float reference filter only
+	Real previousDistances[5];		// Previous distances used to calculate stars in running-average function
+	int32_t echoAverage;			// Current running average of echo time in 1/ECHO_AVERAGE_SCALE microseconds
+	int32_t lastEchoAverage;		// Last frame's echo running average
+	int32_t previousEchoes[5];		// Previous echo times in microseconds
+	Real speed;						// Horizontal speed of paddle
+	uint32_t lastEcho;				// Last echo time passed to the filter or NO_ECHO, kept for the flight recorder
+	uint32_t lastCaptured;			// Capture time of the newest sample in the echo running average
+	uint32_t pendingCaptured;		// Capture time of the sample that moved the paddle, until the move is drawn
+	bool movePending;				// Paddle moved since the last drawn frame, see moveTo
+
+	// pushDistance: adds distance to previousDistances used to calculate the deviation from past distances
+	void pushDistance(Real distance){
+		for(int i = 0; i < 4; i++){
+			previousDistances[i] = previousDistances[i + 1];
+		}
+		previousDistances[4] = distance;
+	}
+
+	// launchRead: starts threaded sensor read, remote paddles are polled in readEcho instead
+	void launchRead(){
+		if(remote == NULL){
+			sensor.launchThreadedRead();
+		}
+	}
+
+	// readEcho: returns echo sample from sensor or of the newest remote distance, NO_ECHO if there is no new remote
+	// distance, remote samples are captured when they are released from the jitter buffer
+	Ultrasonic::EchoSample readEcho(){
+		if(remote != NULL){
+			Ultrasonic::EchoSample sample = {Ultrasonic::distanceToEcho(remote->distance(remoteIndex)), Metrics::nowMicros()};
+			return sample;
+		}
+		return sensor.joinThreadedRead();
+	}
+
+	// updateEchoAverage: averages sample into the echo running average and keeps its capture time
+	void updateEchoAverage(const Ultrasonic::EchoSample& sample){
+		if(sample.echo != Ultrasonic::NO_ECHO){
+			lastCaptured = sample.captured;
+		}
+		updateEchoAverage(sample.echo);
+	}
+
+	// moveTo: moves paddle to column x, a move is timed from the capture of the newest sample until drawn
+	void moveTo(Real x){
+		if(x != position.x && !movePending){
+			pendingCaptured = lastCaptured;
+			movePending = true;
+		}
+		position.x = x;
+	}
+
+	// drawn: records motion-to-photon latency of a pending move once the frame showing it has been drawn
+	void drawn(){
+		if(movePending){
+			Metrics::addMotionToPhoton(pendingCaptured);
+			movePending = false;
+		}
+	}
+
+	// updateEchoAverage: averages echo time into the echo running average and reduces it if it is greater than
+	// one standard deviation from average of dataset, integer version of updateRunningAverage, NO_ECHO is skipped and
+	// longer echoes are clamped to MAX_ECHO_MICROS so remote distances can't overflow the squared deviations
+	void updateEchoAverage(uint32_t echo){
+		if(echo != Ultrasonic::NO_ECHO && echo > Ultrasonic::MAX_ECHO_MICROS){
+			echo = Ultrasonic::MAX_ECHO_MICROS;
+		}
+		lastEcho = echo;
+		if(echo == Ultrasonic::NO_ECHO){
+			return;
+		}
+		for(int i = 0; i < 4; i++){
+			previousEchoes[i] = previousEchoes[i + 1];
+		}
+		int32_t sample = (int32_t)echo;
+		previousEchoes[4] = sample;
+		lastEchoAverage = echoAverage;
+		lastMicros = currentMicros;
+		currentMicros = Clock::micros();
+		int32_t average = Stats::average<int32_t>(previousEchoes, 5);
+		int32_t stddev = Stats::sampleStandardDeviation<int32_t>(previousEchoes, 5);
+		if(sample - average > stddev){
+			previousEchoes[4] = average + stddev;
+		}
+		else if(average - sample > stddev){
+			previousEchoes[4] = average - stddev;
+		}
+		echoAverage = echoAverage + previousEchoes[4]*ECHO_AVERAGE_SCALE/5 - echoAverage/5;
+		// Metres moved are echo time times half the speed of sound
+		Real moved = realRatio((long)(echoAverage - lastEchoAverage)*(long)Ultrasonic::SPEED_OF_SOUND, 2000000L*ECHO_AVERAGE_SCALE);
+		speed = moved/realRatio((long)(lastMicros - currentMicros), 1000000L);
+	}
+
+	// echoColumn: paddle column of the echo running average
+	int echoColumn(const Ultrasonic::ColumnTable& columns, bool mirrored) const{
+		return columns.column(echoAverage/ECHO_AVERAGE_SCALE, mirrored);
+	}
+
+	// updateRunningAverage: averages distance into running average and reduces distance
+	// if it is greater than one standard deviation from average of dataset, NaN samples are skipped
+	// before distance is converted to Real, float reference for updateEchoAverage checked by pongBench
+	void updateRunningAverage(float sample){
+		lastEcho = Ultrasonic::distanceToEcho(sample);
+		if(sample == sample){
+			Real distance = sample;
+			pushDistance(distance);
+			lastRunningAverage = runningAverage;
+			lastMicros = currentMicros;
+			currentMicros = Clock::micros();
+			Real average = Stats::average<Real>(previousDistances, 5);
+			Real stddev = Stats::sampleStandardDeviation<Real>(previousDistances, 5);
+			if(distance - average > stddev){
+				previousDistances[4] = (average + stddev);
+				runningAverage = runningAverage + previousDistances[4]/5 - runningAverage/5;
+			}
+			else if(average - distance > stddev){
+				previousDistances[4] = (average - stddev);
+				runningAverage = runningAverage + previousDistances[4]/5 - runningAverage/5;
+			}
+			else{
+				runningAverage = runningAverage + distance/5 - runningAverage/5;
+			}
+			speed = (runningAverage - lastRunningAverage)/realRatio((long)(lastMicros - currentMicros), 1000000L);
+		}
+	}
+};
+
+class MotionPong{
+public:
+	MotionPong() : MotionPong(PLAYER_VS_PLAYER) {
+	}
+	MotionPong(Gamemode mode) : MotionPong(mode, DEFAULT_PINS, HAL::display()) {
+	}
+	// Table with sensors on pins drawing to display, for processes running several tables
+	MotionPong(Gamemode mode, const PinMap& pins, HAL::Display& display) : mDisplay(display), mDrawContext(display), mColumns(PADDLE_DIM.x) {
+		mGameMode = mode;
+		mPins = pins;
+		mSampler = NULL;
+		mBallPosition = vec2r(OLED::SCREEN_WIDTH/2, OLED::SCREEN_HEIGHT/2);
+		mBallVelocity.x = 0;
+		while(abs(mBallVelocity.x) < BALL_RANGE.x/2){
+			mBallVelocity.x = (rand() % BALL_RANGE.x*2) - BALL_RANGE.x;
+		}
+		mBallVelocity.y = 0;
+		while(abs(mBallVelocity.y) < BALL_RANGE.y/2){
+			mBallVelocity.y = (rand() % BALL_RANGE.y*2) - BALL_RANGE.y;
+		}
+		mBallInitialVelocity = mBallVelocity;
+		mPaddle1.position.y = 0;
+		mPaddle2.position.y = (OLED::SCREEN_HEIGHT - 1) - PADDLE_DIM.y;
+		mP1Score = 0;
+		mP2Score = 0;
+		mShouldClose = false;
+		mRoundState = ROUND_READY_CHECK;
+		mStateStart = Clock::micros();
+		mFrameStart = mStateStart;
+		mCountdownShown = 0;
+		mScoredAt = 0;
+		mCreated = WallClock::now();
+		mFirstFrameDrawn = false;
+	}
+	~MotionPong(){
+		if(mPaddle1.remote != NULL){
+			mRemote.logStats();
+			return;
+		}
+		mPaddle1.sensor.free();
+		mPaddle2.sensor.free();
+	}
+
+	// useRemote: reads paddles from remote controllers on udp port instead of the ultrasonic sensors, call before init
+	bool useRemote(uint16_t port, int jitterDelay){
+		if(!mRemote.open(port, jitterDelay)){
+			return false;
+		}
+		mPaddle1.remote = &mRemote;
+		mPaddle1.remoteIndex = 0;
+		mPaddle2.remote = &mRemote;
+		mPaddle2.remoteIndex = 1;
+		return true;
+	}
+	
+	// init: initialises all hardware and sets initial state of game, the display is brought up on its own thread while
+	// the sensors are requested and settle
+	bool init(){
+		switch(mGameMode){
+		case PLAYER_VS_PLAYER:
+			LOG::message("initializing MotionPong with game-mode: player-vs-player");
+			break;
+		case PLAYER_VS_CPU:
+			LOG::message("initializing MotionPong with game-mode: player-vs-cpu");
+			break;
+		case CPU_VS_CPU:
+			LOG::message("initializing MotionPong with game-mode: cpu-vs-cpu");
+			break;
+		}
+
+		bool displayGood = false;
+		std::thread display([this, &displayGood](){
+			displayGood = OLED::init(mDisplay);
+		});
+		int failedSensor = 0;
+		bool sensorsGood = mPaddle1.remote != NULL || initSensors(failedSensor);
+		display.join();
+		// Errors are written to the display, only once the display thread has finished with it
+		if(!displayGood){
+			throw std::runtime_error(LOG::error("failed to initialize oled expansion", mDisplay));
+			return false;
+		}
+		if(!sensorsGood){
+			throw std::runtime_error(LOG::error(std::string("failed to initialize ultrasonic sensor ") + std::to_string(failedSensor), mDisplay));
+			return false;
+		}
+		LOG::message(std::string("hardware ready after: ") + std::to_string(millisSince(mCreated)) + "ms");
+
+		mPreviousMicros = Clock::micros();
+		return true;
+	}
+
+	// initSensors: requests both sensors and waits for the ones the game-mode reads to settle, in parallel,
+	// returns false with failed set to the sensor (1 or 2) that couldn't be requested, runs while the display is
+	// brought up so it leaves reporting the failure to init
+	bool initSensors(int& failed){
+		bool err = false;
+		mPaddle1.sensor = Ultrasonic::Sensor(err, mPins.trigger1, mPins.echo1);
+		if(err){
+			failed = 1;
+			return false;
+		}
+		mPaddle2.sensor = Ultrasonic::Sensor(err, mPins.trigger2, mPins.echo2);
+		if(err){
+			failed = 2;
+			return false;
+		}
+
+		int readings2 = 0;
+		std::thread settle2;
+		if(mGameMode == PLAYER_VS_PLAYER){
+			settle2 = std::thread([this, &readings2](){
+				readings2 = mPaddle2.sensor.settle(Ultrasonic::SETTLE_TIMEOUT);
+			});
+		}
+		if(mGameMode == PLAYER_VS_PLAYER || mGameMode == PLAYER_VS_CPU){
+			logSettled(1, mPaddle1.sensor.settle(Ultrasonic::SETTLE_TIMEOUT));
+			// Sensor reads run on threads started here or on the sampler pool so the frame loop never creates threads
+			startSampling(mPaddle1.sensor);
+		}
+		if(settle2.joinable()){
+			settle2.join();
+			logSettled(2, readings2);
+			startSampling(mPaddle2.sensor);
+		}
+		return true;
+	}
+
+	// publishFrames: publishes every drawn frame to ring for external viewers (see framebuffer.h)
+	void publishFrames(Framebuffer::Ring* ring){
+		mDrawContext.publishTo(ring);
+	}
+
+	// useSampler: takes sensor reads on pool's threads instead of a worker per sensor, call before init
+	void useSampler(Ultrasonic::SamplerPool* pool){
+		mSampler = pool;
+	}
+
+	// startSampling: hands sensor to the sampler pool or starts its worker
+	void startSampling(Ultrasonic::Sensor& sensor){
+		if(mSampler != NULL){
+			sensor.useSampler(mSampler);
+		}
+		else{
+			sensor.startWorker();
+		}
+	}
+
+	// logSettled: logs readings sensor took to settle, a sensor that didn't settle is used anyway
+	void logSettled(int sensor, int readings){
+		if(readings < 0){
+			LOG::warning(std::string("ultrasonic sensor ") + std::to_string(sensor) + " readings did not settle, starting anyway");
+			return;
+		}
+		LOG::message(std::string("ultrasonic sensor ") + std::to_string(sensor) + " settled after " + std::to_string(readings) + " readings at: " + std::to_string(millisSince(mCreated)) + "ms");
+	}
+
+	// millisSince: milliseconds elapsed since time
+	static long millisSince(WallClock::time_point time){
+		return (long)std::chrono::duration_cast<std::chrono::milliseconds>(WallClock::now() - time).count();
+	}
+
+	// update: advances the round state machine, while playing calculates and updates ball position taking into account collisions
+	template<Gamemode MODE>
+	bool update(){
+		TRACE_SCOPE("MotionPong::update");
+		switch(mRoundState){
+		case ROUND_READY_CHECK:
+			return updateReadyCheck<MODE>();
+		case ROUND_COUNTDOWN:
+			return updateCountdown();
+		case ROUND_SERVE:
+			return serve<MODE>();
+		case ROUND_PLAYING:
+			break;
+		}
+
+		int64_t now = Clock::micros();
+		Real deltaTime = realRatio((long)(now - mPreviousMicros), 1000000L);
+		// Ticks shorter than Real's resolution are carried into the next frame instead of being lost
+		if(deltaTime > 0){
+			mPreviousMicros = now;
+		}
+		vec2r newBallPos;
+		newBallPos.x = mBallPosition.x + mBallVelocity.x*deltaTime;
+		newBallPos.y = mBallPosition.y + mBallVelocity.y*deltaTime;
+		
+		if(newBallPos.x < 0){
+			newBallPos.x = fabs(newBallPos.x);
+			mBallVelocity.x = -mBallVelocity.x;
+		}
+		else if(newBallPos.x >= OLED::SCREEN_WIDTH - BALL_DIM.x - 1){
+			newBallPos.x = 2*(OLED::SCREEN_WIDTH - BALL_DIM.x - 1) - newBallPos.x;
+			mBallVelocity.x = - mBallVelocity.x;
+		}
+
+		if(newBallPos.y < PADDLE_DIM.y && newBallPos.x > mPaddle1.position.x - BALL_DIM.x && newBallPos.x < mPaddle1.position.x + PADDLE_DIM.x){
+			newBallPos.y = 2*PADDLE_DIM.y - newBallPos.y;
+			mBallVelocity.y = -mBallVelocity.y*1.2;
+			mBallVelocity.x += mPaddle1.speed*deltaTime;
+		}
+		else if(newBallPos.y <= 0){
+			mP2Score++;
+			return reset<MODE>();
+		}
+		else if(newBallPos.y > OLED::SCREEN_HEIGHT - (PADDLE_DIM.y + BALL_DIM.y) && newBallPos.x > mPaddle2.position.x - BALL_DIM.x && newBallPos.x < mPaddle2.position.x + PADDLE_DIM.x){
+			newBallPos.y = 2*(OLED::SCREEN_HEIGHT - BALL_DIM.y - PADDLE_DIM.y) - newBallPos.y;
+			mBallVelocity.y = -mBallVelocity.y*1.2;
+			mBallVelocity.x += mPaddle2.speed*deltaTime;
+		}
+		else if(newBallPos.y >= OLED::SCREEN_HEIGHT - BALL_DIM.y){
+			mP1Score++;
+			return reset<MODE>();
+		}
+
+		if(mBallVelocity.y > OLED::SCREEN_HEIGHT/2){
+			mBallVelocity.y = OLED::SCREEN_HEIGHT/2;
+		}
+
+		mBallPosition = newBallPos;
+		return true;
+	}
+	
+	// draw: draws context while concurrently updates sensors, MODE is resolved at compile time so the
+	// per-frame path contains no game-mode branches
+	template<Gamemode MODE>
+	bool draw(){
+		TRACE_SCOPE("MotionPong::draw");
+		if(mShouldClose){
+			return true;
+		}
+		if(MODE == PLAYER_VS_PLAYER){
+			mPaddle2.launchRead();
+		}
+		if(MODE == PLAYER_VS_PLAYER || MODE == PLAYER_VS_CPU){
+			mPaddle1.launchRead();
+		}
+		
+		int status = 0;
+		if(mRoundState == ROUND_PLAYING){
+			status = status | mDisplay.setCursor(GameLayout::TEXT_ROW, 0);
+			status = status | mDisplay.writeChar(mP1Score + '0');
+			status = status | mDisplay.setCursor(GameLayout::TEXT_ROW, GameLayout::TEXT_COLUMNS - 1);
+			status = status | mDisplay.writeChar(mP2Score + '0');
+		}
+		
+		{
+			Metrics::ScopedPhase phase(Metrics::PHASE_RASTER);
+			mDrawContext.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, static_cast<int>(mPaddle1.position.x), static_cast<int>(mPaddle1.position.y));
+			mDrawContext.writeRect(PADDLE_DIM.x, PADDLE_DIM.y, static_cast<int>(mPaddle2.position.x), static_cast<int>(mPaddle2.position.y));
+			if(mRoundState == ROUND_PLAYING){
+				mDrawContext.writeRect(BALL_DIM.x, BALL_DIM.y, static_cast<int>(mBallPosition.x), static_cast<int>(mBallPosition.y));
+			}
+		}
+		mDrawContext.clear();
+		mDrawContext.draw();
+		mDrawContext.swapBuffers();
+		if(MODE == PLAYER_VS_PLAYER || MODE == PLAYER_VS_CPU){
+			mPaddle1.drawn();
+		}
+		if(MODE == PLAYER_VS_PLAYER){
+			mPaddle2.drawn();
+		}
+		if(!mFirstFrameDrawn){
+			mFirstFrameDrawn = true;
+			LOG::message(std::string("first frame drawn after: ") + std::to_string(millisSince(mCreated)) + "ms");
+		}
+		if((MODE == PLAYER_VS_CPU || MODE == CPU_VS_CPU) && mRoundState == ROUND_PLAYING){
+			Real deltaTime = realRatio((long)(Clock::micros() - mPreviousMicros), 1000000L);
+			if(mPaddle2.position.x + PADDLE_DIM.x/2 > mBallPosition.x){
+				mPaddle2.position.x -= fabs(mBallInitialVelocity.x*3)*deltaTime*(1/(1 + rand()%3));
+			}
+			else if(mPaddle1.position.x + PADDLE_DIM.x/2 < mBallPosition.x){
+				mPaddle2.position.x += fabs(mBallInitialVelocity.x*3)*deltaTime*(1/(1 + rand()%3));
+			}
+
+			if(MODE == CPU_VS_CPU){
+				if(mPaddle1.position.x + PADDLE_DIM.x/2 > mBallPosition.x){
+					mPaddle1.position.x -= fabs(mBallInitialVelocity.x*3)*deltaTime*(1/(1 + rand()%3));
+				}
+				else if(mPaddle1.position.x + PADDLE_DIM.x/2 < mBallPosition.x){
+					mPaddle1.position.x += fabs(mBallInitialVelocity.x*3)*deltaTime*(1/(1 + rand()%3));
+				}
+			}
+		}
+
+		if(MODE == PLAYER_VS_PLAYER || MODE == PLAYER_VS_CPU){
+			mPaddle1.updateEchoAverage(mPaddle1.readEcho());
+			mPaddle1.moveTo(mPaddle1.echoColumn(mColumns, false));
+		}
+		if(MODE == PLAYER_VS_PLAYER){
+			mPaddle2.updateEchoAverage(mPaddle2.readEcho());
+			mPaddle2.moveTo(mPaddle2.echoColumn(mColumns, true));
+		}
+		if(mPaddle1.position.x < 0){
+			mPaddle1.position.x = 0;
+		}
+		else if(mPaddle1.position.x >= OLED::SCREEN_WIDTH - PADDLE_DIM.x){
+			mPaddle1.position.x = (OLED::SCREEN_WIDTH - PADDLE_DIM.x) - 1;
+		}
+		if(mPaddle2.position.x < 0){
+			mPaddle2.position.x = 0;
+		}
+		else if(mPaddle2.position.x >= OLED::SCREEN_WIDTH - PADDLE_DIM.x){
+			mPaddle2.position.x = (OLED::SCREEN_WIDTH - PADDLE_DIM.x) - 1;
+		}
+
+		if(mRoundState != ROUND_PLAYING){
+			waitForNextFrame();
+		}
+		mFrameStart = Clock::micros();
+		
+		if(status < 0){
+			return false;
+		}
+		return true;
+	}
+
+	// playersAreReady: returns true if players hands are close to sensors signifying that player is ready for next round,
+	// paddle positions are sampled from the sensors by draw
+	template<Gamemode MODE>
+	bool playersAreReady(){
+		if(MODE == PLAYER_VS_PLAYER){
+			return mPaddle1.position.x < (3*OLED::SCREEN_WIDTH / 4) && mPaddle2.position.x > (OLED::SCREEN_WIDTH - PADDLE_DIM.x) - (3*OLED::SCREEN_WIDTH / 4);
+		}
+		else if(MODE == PLAYER_VS_CPU){
+			return mPaddle1.position.x < (3*OLED::SCREEN_WIDTH / 4);
+		}
+		return true;
+	}
+
+	// Game calls reset when player scores, sets should close to true if a player wins (gets 4 points)
+	// otherwise starts the next round's ready-check, the round then advances without blocking in update
+	template<Gamemode MODE>
+	bool reset(){ 
+		Metrics::ScopedPhase phase(Metrics::PHASE_RESET);
+		mScoredAt = Metrics::nowMicros();
+		mDrawContext.clear();
+		OLED::quickClear(mDisplay);
+		mDrawContext.dumpBuffer();
+
+		if(mP1Score >= 4){
+			mDisplay.write("Player 1 wins!");
+			mShouldClose = true;
+			return true;
+		}
+		else if(mP2Score >= 4){
+			mDisplay.write("Player 2 wins!");
+			mShouldClose = true;
+			return true;
+		}
+		if(MODE != CPU_VS_CPU){
+			mDisplay.setCursor(GameLayout::TEXT_ROW, 0);
+			mDisplay.write("Place your hands near the sensors!");
+			enterState(ROUND_READY_CHECK);
+		}
+		else{
+			startCountdown();
+		}
+		return true;
+	}
+	
+	// Returns should close
+	bool shouldClose(){
+		return this->mShouldClose;
+	}
+
+	// updateReadyCheck: starts countdown once players have been ready for READY_HOLD_TIME
+	template<Gamemode MODE>
+	bool updateReadyCheck(){
+		int64_t now = Clock::micros();
+		if(!playersAreReady<MODE>()){
+			mStateStart = now;
+		}
+		else if(now - mStateStart >= Clock::toMicros(READY_HOLD_TIME)){
+			startCountdown();
+		}
+		return true;
+	}
+
+	// startCountdown: clears ready message and starts countdown
+	void startCountdown(){
+		OLED::quickClear(mDisplay);
+		mDrawContext.dumpBuffer();
+		mCountdownShown = 0;
+		enterState(ROUND_COUNTDOWN);
+	}
+
+	// updateCountdown: writes remaining seconds of countdown when it changes and moves to serve when it expires
+	bool updateCountdown(){
+		int remaining = COUNTDOWN_SECONDS - (int)((Clock::micros() - mStateStart)/1000000);
+		if(remaining <= 0){
+			enterState(ROUND_SERVE);
+			return true;
+		}
+		if(remaining != mCountdownShown){
+			mCountdownShown = remaining;
+			int status = mDisplay.setCursor(GameLayout::TEXT_ROW, 0);
+			status = status | mDisplay.writeChar(remaining + '0');
+			if(status < 0){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// serve: resets ball with a random velocity and starts play
+	template<Gamemode MODE>
+	bool serve(){
+		mBallPosition = vec2r(OLED::SCREEN_WIDTH/2, OLED::SCREEN_HEIGHT/2);
+		mBallVelocity.x = 0;
+		while(abs(mBallVelocity.x) < BALL_RANGE.x/2){
+			mBallVelocity.x = (rand() % BALL_RANGE.x*2) - BALL_RANGE.x;
+		}
+		mBallVelocity.y = 0;
+		while(abs(mBallVelocity.y) < BALL_RANGE.y/2){
+			mBallVelocity.y = (rand() % BALL_RANGE.y*2) - BALL_RANGE.y;
+		}
+		if(MODE == PLAYER_VS_CPU || MODE == CPU_VS_CPU){
+			mPaddle2.position.x = (OLED::SCREEN_WIDTH/2) - PADDLE_DIM.x/2;
+			if(MODE == CPU_VS_CPU){
+				mPaddle1.position.x = (OLED::SCREEN_WIDTH/2) - PADDLE_DIM.x/2;
+			}
+		}
+		mBallInitialVelocity = mBallVelocity;
+		mShouldClose = false;
+		mPreviousMicros = Clock::micros();
+		Metrics::record(Metrics::PHASE_ROUND_WAIT, Metrics::nowMicros() - mScoredAt);
+		enterState(ROUND_PLAYING);
+		return true;
+	}
+
+	// enterState: moves round to state and records time it was entered
+	void enterState(RoundState state){
+		mRoundState = state;
+		mStateStart = Clock::micros();
+	}
+
+	// waitForNextFrame: sleeps for remainder of IDLE_FRAME_PERIOD so waiting between rounds leaves the CPU idle
+	void waitForNextFrame(){
+		Clock::sleepUntil(mFrameStart + Clock::toMicros(IDLE_FRAME_PERIOD));
+	}
+
+	// record: copies game state into flight recorder frame
+	void record(Recorder::FrameRecord& frame){
+		frame.distance1 = mPaddle1.lastEcho == Ultrasonic::NO_ECHO ? std::numeric_limits<float>::quiet_NaN() : Ultrasonic::echoToDistance(mPaddle1.lastEcho);
+		frame.distance2 = mPaddle2.lastEcho == Ultrasonic::NO_ECHO ? std::numeric_limits<float>::quiet_NaN() : Ultrasonic::echoToDistance(mPaddle2.lastEcho);
+		frame.paddle1 = realToFloat(mPaddle1.position.x);
+		frame.paddle2 = realToFloat(mPaddle2.position.x);
+		frame.ballX = realToFloat(mBallPosition.x);
+		frame.ballY = realToFloat(mBallPosition.y);
+		frame.ballVelocityX = realToFloat(mBallVelocity.x);
+		frame.ballVelocityY = realToFloat(mBallVelocity.y);
+		frame.state = (uint8_t)mRoundState;
+		frame.score1 = (uint8_t)mP1Score;
+		frame.score2 = (uint8_t)mP2Score;
+	}
+
+	// Returns game-mode selected at construction
+	Gamemode gameMode(){
+		return this->mGameMode;
+	}
+
+	// Returns current state of round
+	RoundState roundState(){
+		return this->mRoundState;
+	}
+	
+private:
+	Gamemode mGameMode;					// Current game-mode
+	HAL::Display& mDisplay;				// Display the table draws to
+	PinMap mPins;						// Gpio pins of the table's sensors
+	Ultrasonic::SamplerPool* mSampler;	// Threads shared with other tables taking sensor reads, NULL for a worker per sensor
+
+	int64_t mPreviousMicros;			// Clock time of the previous physics step in microseconds
+	
+	OLED::DrawContext mDrawContext;		// DrawContext: used to update oled screen, defined in oled.h
+	Ultrasonic::ColumnTable mColumns;	// Paddle column of each echo time
+	PongPaddle mPaddle1;				// Player 1's paddle
+	PongPaddle mPaddle2;				// Player 2's paddle
+	Network::PaddleReceiver mRemote;	// Remote paddle input, only opened by useRemote
+
+	bool mShouldClose;					// Close state of program
+	
+	vec2r mBallPosition;				// Ball's position vector
+	vec2r mBallVelocity;				// Ball's velocity vector
+	vec2r mBallInitialVelocity;			// Ball's initial velocity vector
+	
+	int mP1Score;						// Player one's score
+	int mP2Score;						// Player two's score
+
+	RoundState mRoundState;						// Current state of round
+	int64_t mStateStart;						// Clock time round state was entered, or time players became ready during ready-check
+	int64_t mFrameStart;						// Clock time previous frame finished
+	int mCountdownShown;						// Countdown digit currently on screen
+	uint32_t mScoredAt;							// Time last point was scored in microseconds, see Metrics::PHASE_ROUND_WAIT
+	WallClock::time_point mCreated;				// Wall time game was constructed, start of time-to-first-frame
+	bool mFirstFrameDrawn;						// First frame has been drawn and time-to-first-frame logged
+	
+};
+
+#endif // MOTIONPONG_H
@@ -0,0 +1,409 @@
+/*///////////////////////////////////////
+// network.h: This file contains methods for
+// receiving paddle positions from remote
+// controllers over UDP, packets are sequence
+// numbered and pass through a jitter buffer
+// so reordered and lost packets are handled
+*/
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "log.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits>
+#include <chrono>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace Network{
+
+	const uint16_t DEFAULT_PORT = 5005;
+	const uint16_t PACKET_MAGIC = 0x4D50; // "MP"
+	const uint8_t PACKET_VERSION = 1;
+	const int PACKET_SIZE = 16;
+	const uint16_t NO_DISTANCE = 0xFFFF; // Distance value sent when remote sensor has no reading
+	const int NUM_PADDLES = 2;
+	const int JITTER_SLOTS = 32; // Maximum packets held in each paddle's jitter buffer
+	const uint32_t RESYNC_WINDOW = 128; // Sequence jump, back or ahead, treated as a restarted sender (over a second at 100Hz)
+
+	// PaddlePacket: one paddle position sample, encoded in network byte order as:
+	// magic(2) version(1) paddle(1) sequence(4) distance in mm(2) reserved(2) send time in microseconds(4)
+	struct PaddlePacket{
+		uint8_t paddle;			// Paddle index 0 or 1
+		uint32_t sequence;		// Per paddle sequence number, wraps
+		uint16_t distance;		// Distance in millimetres or NO_DISTANCE
+		uint32_t sendTime;		// Sender's clock in microseconds, used to measure latency
+	};
+
+	// PaddleSample: latest sample released from a jitter buffer
+	struct PaddleSample{
+		float distance;			// Distance in metres, NaN if remote sensor had no reading
+		uint32_t sequence;		// Sequence number of packet
+		uint32_t sendTime;		// Sender's clock in microseconds
+	};
+
+	// PaddleStats: counters for one paddle's packet stream
+	struct PaddleStats{
+		uint32_t received;		// Packets accepted into jitter buffer
+		uint32_t lost;			// Sequence numbers never released
+		uint32_t late;			// Packets dropped because a newer packet was already released
+		uint32_t reordered;		// Packets that arrived out of order but in time to be released
+		uint32_t duplicates;	// Packets dropped because sequence number was already buffered
+		uint32_t restarts;		// Sequence jumps beyond RESYNC_WINDOW the buffer resynchronised on
+	};
+
+	// nowMicros: monotonic clock in microseconds
+	int64_t nowMicros(){
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// sequenceAfter: true if sequence a is newer than b, handles wrap around
+	bool sequenceAfter(uint32_t a, uint32_t b){
+		return (int32_t)(a - b) > 0;
+	}
+
+	// encodePacket: writes packet to buffer of PACKET_SIZE bytes
+	void encodePacket(const PaddlePacket& packet, uint8_t buffer[PACKET_SIZE]){
+		uint16_t magic = htons(PACKET_MAGIC);
+		uint32_t sequence = htonl(packet.sequence);
+		uint16_t distance = htons(packet.distance);
+		uint16_t reserved = 0;
+		uint32_t sendTime = htonl(packet.sendTime);
+		memcpy(buffer, &magic, 2);
+		buffer[2] = PACKET_VERSION;
+		buffer[3] = packet.paddle;
+		memcpy(buffer + 4, &sequence, 4);
+		memcpy(buffer + 8, &distance, 2);
+		memcpy(buffer + 10, &reserved, 2);
+		memcpy(buffer + 12, &sendTime, 4);
+	}
+
+	// decodePacket: reads packet from buffer, returns false if buffer is not a valid paddle packet
+	bool decodePacket(const uint8_t* buffer, int size, PaddlePacket& packet){
+		if(size != PACKET_SIZE){
+			return false;
+		}
+		uint16_t magic;
+		memcpy(&magic, buffer, 2);
+		if(ntohs(magic) != PACKET_MAGIC || buffer[2] != PACKET_VERSION || buffer[3] >= NUM_PADDLES){
+			return false;
+		}
+		packet.paddle = buffer[3];
+		memcpy(&packet.sequence, buffer + 4, 4);
+		memcpy(&packet.distance, buffer + 8, 2);
+		memcpy(&packet.sendTime, buffer + 12, 4);
+		packet.sequence = ntohl(packet.sequence);
+		packet.distance = ntohs(packet.distance);
+		packet.sendTime = ntohl(packet.sendTime);
+		return true;
+	}
+
+	// class JitterBuffer: holds packets for a fixed delay and releases them in sequence order,
+	// packets arriving after a newer packet was released are dropped unless the sequence jumped
+	// back by more than RESYNC_WINDOW, which is a restarted sender (or a corrupt packet having
+	// been released) and starts the stream over
+	class JitterBuffer{
+	public:
+		JitterBuffer(){
+			mDelay = 0;
+			mCount = 0;
+			mStarted = false;
+			mLastSequence = 0;
+			mReleased = ~(uint64_t)0;
+			mFresh = false;
+			mLatest.distance = std::numeric_limits<float>::quiet_NaN();
+			mLatest.sequence = 0;
+			mLatest.sendTime = 0;
+			memset(&mStats, 0, sizeof(mStats));
+		}
+
+		// setDelay: sets time packets are held in microseconds, 0 releases packets as soon as they arrive
+		void setDelay(int64_t delay){
+			mDelay = delay;
+		}
+
+		// push: inserts packet that arrived at time: arrival in sequence order
+		void push(const PaddlePacket& packet, int64_t arrival){
+			if(mCount == JITTER_SLOTS){
+				// Buffer is full: release oldest packet early to make room
+				releaseUpTo(0);
+			}
+			if(mStarted && !sequenceAfter(packet.sequence, mLastSequence)){
+				uint32_t behind = mLastSequence - packet.sequence;
+				if(behind > RESYNC_WINDOW){
+					// Held packets belong to the old stream
+					mStats.restarts++;
+					mStarted = false;
+					mCount = 0;
+				}
+				else{
+					// A packet skipped by a release was counted lost, now it is only late
+					if(behind < 64 && (mReleased & ((uint64_t)1 << behind)) == 0){
+						mReleased |= (uint64_t)1 << behind;
+						mStats.lost--;
+					}
+					mStats.late++;
+					return;
+				}
+			}
+			int index = mCount;
+			while(index > 0 && sequenceAfter(mPending[index - 1].sequence, packet.sequence)){
+				index--;
+			}
+			if(index > 0 && mPending[index - 1].sequence == packet.sequence){
+				mStats.duplicates++;
+				return;
+			}
+			if(index < mCount){
+				mStats.reordered++;
+			}
+			for(int i = mCount; i > index; i--){
+				mPending[i] = mPending[i - 1];
+				mArrival[i] = mArrival[i - 1];
+			}
+			mPending[index] = packet;
+			mArrival[index] = arrival;
+			mCount++;
+			mStats.received++;
+		}
+
+		// release: releases every packet up to the newest one that has been held for the delay
+		void release(int64_t now){
+			int last = -1;
+			for(int i = 0; i < mCount; i++){
+				if(now - mArrival[i] >= mDelay){
+					last = i;
+				}
+			}
+			if(last >= 0){
+				releaseUpTo(last);
+			}
+		}
+
+		// next: returns true and writes sample if a packet was released since the last call
+		bool next(PaddleSample& sample){
+			if(!mFresh){
+				return false;
+			}
+			sample = mLatest;
+			mFresh = false;
+			return true;
+		}
+
+		const PaddleStats& stats() const{
+			return mStats;
+		}
+
+	private:
+		// releaseUpTo: pops packets 0 to index from the front of the buffer
+		void releaseUpTo(int index){
+			for(int i = 0; i <= index; i++){
+				const PaddlePacket& packet = mPending[i];
+				uint32_t gap = packet.sequence - mLastSequence;
+				if(!mStarted || gap > RESYNC_WINDOW){
+					if(mStarted){
+						mStats.restarts++;
+					}
+					// Sequences before a (re)start were never counted lost
+					mReleased = ~(uint64_t)0;
+				}
+				else{
+					mStats.lost += gap - 1;
+					mReleased = gap < 64 ? (mReleased << gap) | 1 : 1;
+				}
+				mLastSequence = packet.sequence;
+				mStarted = true;
+			}
+			const PaddlePacket& newest = mPending[index];
+			mLatest.distance = newest.distance == NO_DISTANCE ? std::numeric_limits<float>::quiet_NaN() : newest.distance/1000.0f;
+			mLatest.sequence = newest.sequence;
+			mLatest.sendTime = newest.sendTime;
+			mFresh = true;
+			mCount -= index + 1;
+			for(int i = 0; i < mCount; i++){
+				mPending[i] = mPending[i + index + 1];
+				mArrival[i] = mArrival[i + index + 1];
+			}
+		}
+
+		PaddlePacket mPending[JITTER_SLOTS];	// Held packets sorted by sequence number
+		int64_t mArrival[JITTER_SLOTS];			// Arrival time of each held packet in microseconds
+		int mCount;								// Number of held packets
+		int64_t mDelay;							// Time packets are held in microseconds
+		bool mStarted;							// True once a packet has been released
+		uint32_t mLastSequence;					// Sequence number of last released packet
+		uint64_t mReleased;						// Bit i clear if sequence mLastSequence - i was counted lost
+		PaddleSample mLatest;					// Newest released sample
+		bool mFresh;							// True if mLatest has not been read
+		PaddleStats mStats;						// Stream counters
+	};
+
+	// class PaddleReceiver: non-blocking UDP socket feeding one jitter buffer per paddle,
+	// polled from the game loop in place of the ultrasonic sensors
+	class PaddleReceiver{
+	public:
+		PaddleReceiver(){
+			mSocket = -1;
+		}
+		~PaddleReceiver(){
+			close();
+		}
+
+		// open: binds receiver to UDP port, jitterDelay is time in milliseconds packets are held to be reordered
+		bool open(uint16_t port, int jitterDelay = 0){
+			LOG::message(std::string("listening for remote paddles on udp port: ") + std::to_string(port) + " with jitter delay: " + std::to_string(jitterDelay) + "ms");
+			mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+			if(mSocket < 0){
+				LOG::error(std::string("failed to create udp socket: ") + strerror(errno));
+				return false;
+			}
+			int flags = fcntl(mSocket, F_GETFL, 0);
+			if(flags < 0 || fcntl(mSocket, F_SETFL, flags | O_NONBLOCK) < 0){
+				LOG::error(std::string("failed to make udp socket non-blocking: ") + strerror(errno));
+				close();
+				return false;
+			}
+			sockaddr_in address;
+			memset(&address, 0, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_ANY);
+			address.sin_port = htons(port);
+			if(bind(mSocket, (sockaddr*)&address, sizeof(address)) < 0){
+				LOG::error(std::string("failed to bind udp port: ") + std::to_string(port) + ": " + strerror(errno));
+				close();
+				return false;
+			}
+			for(int i = 0; i < NUM_PADDLES; i++){
+				mBuffers[i].setDelay((int64_t)jitterDelay*1000);
+			}
+			return true;
+		}
+
+		// close: closes socket
+		void close(){
+			if(mSocket >= 0){
+				::close(mSocket);
+				mSocket = -1;
+			}
+		}
+
+		// poll: drains all queued datagrams into the jitter buffers and releases packets that are due
+		void poll(){
+			if(mSocket < 0){
+				return;
+			}
+			int64_t now = nowMicros();
+			uint8_t buffer[PACKET_SIZE + 1];
+			while(true){
+				ssize_t size = recv(mSocket, buffer, sizeof(buffer), MSG_DONTWAIT);
+				if(size < 0){
+					if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+						LOG_WARNING(UDP_RECEIVE_FAILED, errno);
+					}
+					break;
+				}
+				PaddlePacket packet;
+				if(decodePacket(buffer, (int)size, packet)){
+					mBuffers[packet.paddle].push(packet, now);
+				}
+			}
+			for(int i = 0; i < NUM_PADDLES; i++){
+				mBuffers[i].release(now);
+			}
+		}
+
+		// next: polls socket and writes the newest released sample for paddle, returns false if there is none
+		bool next(int paddle, PaddleSample& sample){
+			poll();
+			return mBuffers[paddle].next(sample);
+		}
+
+		// distance: returns newest distance in metres for paddle or NaN if no new sample has been released,
+		// NaN is ignored by PongPaddle::updateRunningAverage
+		float distance(int paddle){
+			PaddleSample sample;
+			if(!next(paddle, sample)){
+				return std::numeric_limits<float>::quiet_NaN();
+			}
+			return sample.distance;
+		}
+
+		const PaddleStats& stats(int paddle) const{
+			return mBuffers[paddle].stats();
+		}
+
+		// logStats: writes packet counters of each paddle to log
+		void logStats(){
+			for(int i = 0; i < NUM_PADDLES; i++){
+				const PaddleStats& stats = mBuffers[i].stats();
+				LOG::message(std::string("remote paddle ") + std::to_string(i + 1) + ": received: " + std::to_string(stats.received) + " lost: " + std::to_string(stats.lost) + " late: " + std::to_string(stats.late) + " reordered: " + std::to_string(stats.reordered) + " duplicates: " + std::to_string(stats.duplicates) + " restarts: " + std::to_string(stats.restarts));
+			}
+		}
+
+	private:
+		int mSocket;							// UDP socket file descriptor
+		JitterBuffer mBuffers[NUM_PADDLES];		// Jitter buffer of each paddle
+	};
+
+	// class PaddleSender: sends paddle packets to a receiver, used by remote controllers
+	class PaddleSender{
+	public:
+		PaddleSender(){
+			mSocket = -1;
+			mSequence[0] = 0;
+			mSequence[1] = 0;
+		}
+		~PaddleSender(){
+			if(mSocket >= 0){
+				::close(mSocket);
+			}
+		}
+
+		// open: creates socket sending to host:port
+		bool open(const char* host, uint16_t port){
+			mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+			if(mSocket < 0){
+				LOG::error(std::string("failed to create udp socket: ") + strerror(errno));
+				return false;
+			}
+			memset(&mAddress, 0, sizeof(mAddress));
+			mAddress.sin_family = AF_INET;
+			mAddress.sin_port = htons(port);
+			if(inet_pton(AF_INET, host, &mAddress.sin_addr) != 1){
+				LOG::error(std::string("invalid receiver address: ") + host);
+				return false;
+			}
+			return true;
+		}
+
+		// send: sends distance in metres for paddle with the next sequence number, NaN is sent as NO_DISTANCE
+		bool send(int paddle, float distance){
+			PaddlePacket packet;
+			packet.paddle = (uint8_t)paddle;
+			packet.sequence = mSequence[paddle]++;
+			packet.distance = distance == distance ? (uint16_t)(distance*1000.0f) : NO_DISTANCE;
+			packet.sendTime = (uint32_t)nowMicros();
+			return sendPacket(packet);
+		}
+
+		// sendPacket: sends a prepared packet
+		bool sendPacket(const PaddlePacket& packet){
+			uint8_t buffer[PACKET_SIZE];
+			encodePacket(packet, buffer);
+			return sendto(mSocket, buffer, PACKET_SIZE, 0, (sockaddr*)&mAddress, sizeof(mAddress)) == PACKET_SIZE;
+		}
+
+	private:
+		int mSocket;						// UDP socket file descriptor
+		sockaddr_in mAddress;				// Receiver address
+		uint32_t mSequence[NUM_PADDLES];	// Next sequence number of each paddle
+	};
+}
+
+#endif // NETWORK_H
@@ -3,7 +3,9 @@
 // efficiently updating the oled-exp's
 // screen to do this we use a double 
 // image (buffer) technique to increase 
-// efficiency
+// efficiency, each image tracks the columns
+// written on every page so frame diffs only
+// visit the regions of moving objects
 // 
 */
 
@@ -11,6 +13,13 @@
 #define OLED_H
 
 #include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "fixed.h"
+#include "framebuffer.h"
+
+#include <cmath>
+#include <utility>
 
 // class vec2: generic 2 dimensional vector type for mathematical calculations
 template<typename VecType>
@@ -59,156 +68,214 @@ void stretchTo(VecType& vec, VecType length){
 
 typedef vec2<float> vec2f;
 typedef vec2<int> vec2i;
+typedef vec2<Real> vec2r;	// Game physics vector, fixed-point when FIXED_POINT is defined
 
 namespace OLED{
 	
+	// Panel: compile-time geometry of an SSD1306-class panel W pixels wide and H pixels high, images and draw
+	// contexts are sized and their loops bounded by it
+	template<int W, int H>
+	struct Panel{
+		static_assert(H%8 == 0, "panel height must be a whole number of byte rows");
+		static const int WIDTH = W;
+		static const int HEIGHT = H;
+		static const int ROWS = H/8;			// Byte rows (pages), each byte holds eight vertical pixels
+		static const int BYTES = W*(H/8);
+	};
+
+	typedef Panel<128, 64> Panel128x64;		// Onion oled-exp
+	typedef Panel<128, 32> Panel128x32;
+	typedef Panel<72, 40> Panel72x40;
+	typedef Panel<HAL::DISPLAY_WIDTH, HAL::DISPLAY_HEIGHT> GamePanel;	// Panel the game is built for
+
 	// Number of byte rows on oled expansion
-	const int NUM_ROWS = 8;
+	const int NUM_ROWS = GamePanel::ROWS;
 	// Screen width of oled
-	const int SCREEN_WIDTH = OLED_EXP_WIDTH;
+	const int SCREEN_WIDTH = GamePanel::WIDTH;
 	// Screen height of oled
-	const int SCREEN_HEIGHT = OLED_EXP_HEIGHT;
+	const int SCREEN_HEIGHT = GamePanel::HEIGHT;
+
+	static_assert(GamePanel::BYTES <= Framebuffer::MAX_FRAME_BYTES, "frames must fit a framebuffer slot");
 	
-	class DrawContext;
+	template<typename PANEL>
+	class BasicDrawContext;
 
-	// Image class defines an array of bytes (uint8_t) represeting all pixels on the oled-exp
+	// BasicImage class defines an array of bytes (uint8_t) represeting all pixels of a PANEL sized screen
 	// also defines various methods for manipulating the image
-	class Image{
-		friend class OLED::DrawContext;
+	template<typename PANEL>
+	class BasicImage{
+		friend class OLED::BasicDrawContext<PANEL>;
 	public:
-		Image(){ // Default constructor fills image buffer with zeros
-			buffer = new uint8_t[SCREEN_WIDTH*NUM_ROWS];
-			for(int i = 0; i < SCREEN_WIDTH*NUM_ROWS; i++){
+		BasicImage(){ // Default constructor fills image buffer with zeros
+			buffer = new uint8_t[PANEL::BYTES];
+			for(int i = 0; i < PANEL::BYTES; i++){
 				buffer[i] = 0;
 			}
+			markClean();
 		}
-		~Image(){
+		~BasicImage(){
 			if(buffer != NULL){
 				delete[] buffer;
 			}
 		}
 		
 		// Bitwise XOR operator -> XOR's each byte with that of another image
-		Image operator^(Image& other){ 
+		BasicImage operator^(BasicImage& other){ 
 			
-			Image xored = Image();
+			BasicImage xored = BasicImage();
 			if(this->buffer == NULL || other.buffer == NULL){
-				LOG::warning("invalid use of operator ^ on class Image: cannot perform bitwise XOR on null buffer");
+				LOG_WARNING(IMAGE_XOR_NULL);
 				return xored;
 			}
-			for(int i = 0; i < NUM_ROWS; i++){
-				for(int j = 0; j < SCREEN_WIDTH; j++){
-					xored.buffer[i*SCREEN_WIDTH + j] = this->buffer[i*SCREEN_WIDTH + j]^other.buffer[i*SCREEN_WIDTH + j];
+			xored.markAll();
+			for(int i = 0; i < PANEL::ROWS; i++){
+				for(int j = 0; j < PANEL::WIDTH; j++){
+					xored.buffer[i*PANEL::WIDTH + j] = this->buffer[i*PANEL::WIDTH + j]^other.buffer[i*PANEL::WIDTH + j];
 				}
 			}
 			return xored;
 		}
 		
 		// Bitwise AND operator -> AND's each byte with that of another image
-		Image operator&(Image& other){ 
+		BasicImage operator&(BasicImage& other){ 
 			
-			Image anded = Image();
+			BasicImage anded = BasicImage();
 			
 			if(this->buffer == NULL || other.buffer == NULL){
-				LOG::warning("invalid use of operator & on class Image: cannot perform bitwise AND on null buffer");
+				LOG_WARNING(IMAGE_AND_NULL);
 				return anded;
 			}
+			anded.markAll();
 			
-			for(int i = 0; i < NUM_ROWS; i++){
-				for(int j = 0; j < SCREEN_WIDTH; j++){
-					anded.buffer[i*SCREEN_WIDTH + j] = this->buffer[i*SCREEN_WIDTH + j]&other.buffer[i*SCREEN_WIDTH + j];
+			for(int i = 0; i < PANEL::ROWS; i++){
+				for(int j = 0; j < PANEL::WIDTH; j++){
+					anded.buffer[i*PANEL::WIDTH + j] = this->buffer[i*PANEL::WIDTH + j]&other.buffer[i*PANEL::WIDTH + j];
 				}
 			}
 			
 			return anded;
 		}
 		
+		// writeDifference: overwrites image with (a ^ b) & mask, same as the operators without allocating a temporary,
+		// only the union of a's and b's dirty columns is visited and becomes the image's dirty columns
+		bool writeDifference(const BasicImage& a, const BasicImage& b, const BasicImage& mask){
+			if(this->buffer == NULL || a.buffer == NULL || b.buffer == NULL || mask.buffer == NULL){
+				LOG_WARNING(WRITE_DIFFERENCE_NULL);
+				return false;
+			}
+			for(int i = 0; i < PANEL::ROWS; i++){
+				int start = a.dirtyStart[i] < b.dirtyStart[i] ? a.dirtyStart[i] : b.dirtyStart[i];
+				int end = a.dirtyEnd[i] > b.dirtyEnd[i] ? a.dirtyEnd[i] : b.dirtyEnd[i];
+				for(int j = start; j < end; j++){
+					this->buffer[i*PANEL::WIDTH + j] = (a.buffer[i*PANEL::WIDTH + j]^b.buffer[i*PANEL::WIDTH + j])&mask.buffer[i*PANEL::WIDTH + j];
+				}
+				dirtyStart[i] = start;
+				dirtyEnd[i] = end;
+			}
+			return true;
+		}
+		
 		// Overloaded assignment immediantly copies buffer data to image
-		void operator=(const Image& image){ 
+		void operator=(const BasicImage& image){ 
 			if(this->buffer == NULL){
-				Image();
+				BasicImage();
 			}
 			for(int i = 0; i < this->size(); i++){
 				this->buffer[i] = image.buffer[i]; 
 			}
+			for(int i = 0; i < PANEL::ROWS; i++){
+				dirtyStart[i] = image.dirtyStart[i];
+				dirtyEnd[i] = image.dirtyEnd[i];
+			}
 		}
 		
 		// writePixel: writes pixel to image at (x, y)
 		bool writePixel(unsigned x, unsigned y){ 
 			if(buffer == NULL){
-				LOG::warning("failed to write pixel to image: buffer is deleted");
+				LOG_WARNING(WRITE_PIXEL_DELETED);
 				return false;
 			}
-			if(x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT){
-				LOG::warning("failed to write pixel to image: coordinates out of bounds");
+			if(x >= PANEL::WIDTH || y >= PANEL::HEIGHT){
+				LOG_WARNING(WRITE_PIXEL_OUT_OF_BOUNDS, x, y);
 				return false;
 			}
-			unsigned row = y / NUM_ROWS;
-			uint8_t byte = 1 << (y % NUM_ROWS);
-			buffer[row*SCREEN_WIDTH + x] |= byte;
+			unsigned row = y / 8;
+			uint8_t byte = 1 << (y % 8);
+			buffer[row*PANEL::WIDTH + x] |= byte;
+			markDirty(row, x, x + 1);
 			return true;
 		}
 
 		// writeByte: writes a given byte to image at a given row and column
 		bool writeByte(unsigned row, unsigned column, uint8_t byte){ 
 			if(buffer == NULL){
-				LOG::warning("failed to write pixel to image: buffer is deleted");
+				LOG_WARNING(WRITE_PIXEL_DELETED);
 				return false;
 			}
-			if(column >= SCREEN_WIDTH || row >= NUM_ROWS){
-				LOG::warning("failed to write byte to image: position out of bounds");
+			if(column >= PANEL::WIDTH || row >= PANEL::ROWS){
+				LOG_WARNING(WRITE_BYTE_OUT_OF_BOUNDS, row, column);
 				return false;
 			}
-			buffer[row*SCREEN_WIDTH + column] |= byte;
+			buffer[row*PANEL::WIDTH + column] |= byte;
+			markDirty(row, column, column + 1);
 			return true;
 		}
 		
 		// writeRect: writes a rectangle to image starting at (x, y) with dimensions width and height
 		bool writeRect(unsigned width, unsigned height, unsigned x, unsigned y){ 
-				if(x + width >= SCREEN_WIDTH || y + height >= SCREEN_HEIGHT || buffer == NULL){
-				LOG::warning(std::string("failed to write rect to image with coordinates: (") + std::to_string(x) + ", " + std::to_string(y) + ") and dimensions: " + std::to_string(width) + "x" + std::to_string(height));
+				if(x + width >= PANEL::WIDTH || y + height >= PANEL::HEIGHT || buffer == NULL){
+				LOG_WARNING(WRITE_RECT_FAILED, x, y, width, height);
 				return false;
 			}
 			for(int i = y; i < y + height; i++){
 				for(int j = x; j < x + width; j++){
-					unsigned row = i/NUM_ROWS;
-					uint8_t byte = 1 << (i%NUM_ROWS);
-					buffer[row*SCREEN_WIDTH + j] |= byte;
+					unsigned row = i/8;
+					uint8_t byte = 1 << (i%8);
+					buffer[row*PANEL::WIDTH + j] |= byte;
 				}
 			}
+			for(unsigned row = y/8; height > 0 && row <= (y + height - 1)/8; row++){
+				markDirty(row, x, x + width);
+			}
 
 			return true;
 		}
 		
-		// clear: fills buffer with zeros
+		// clear: fills buffer with zeros, only dirty columns can hold set bytes so only they are cleared
 		bool clear(){ 
 			if(buffer == NULL){
-				LOG::warning("failed to write pixel to image: buffer was deleted");
+				LOG_WARNING(CLEAR_DELETED);
 				return false;
 			}
-			for(int i = 0; i < this->size(); i++){
-				buffer[i] = 0;
+			for(int i = 0; i < PANEL::ROWS; i++){
+				for(int j = dirtyStart[i]; j < dirtyEnd[i]; j++){
+					buffer[i*PANEL::WIDTH + j] = 0;
+				}
 			}
+			markClean();
 			return true;
 		}
 		
 		// clearExclusiveBytes: clears pixels of oled excluding nextImages pixels
-		bool clearExclusiveBytes(Image* nextImage){ 
+		bool clearExclusiveBytes(BasicImage* nextImage, HAL::Display& display = HAL::display()){ 
 			if(buffer == NULL){
-				LOG::warning("failed to undraw image: buffer was deleted");
+				LOG_WARNING(UNDRAW_DELETED);
 				return false;
 			}
-			for(int i = 0; i < NUM_ROWS; i++){
-				for(int j = 0; j < SCREEN_WIDTH; j++){
-					uint8_t byte = buffer[i*SCREEN_WIDTH + j];
+			uint32_t written = 0;
+			for(int i = 0; i < PANEL::ROWS; i++){
+				for(int j = dirtyStart[i]; j < dirtyEnd[i]; j++){
+					uint8_t byte = buffer[i*PANEL::WIDTH + j];
 					if(byte > 0){
 						byte = ~byte;
-						byte = byte & nextImage->buffer[i*SCREEN_WIDTH + j];
-						oledSetCursorByPixel(i, j);
-						oledWriteByte(byte);
+						byte = byte & nextImage->buffer[i*PANEL::WIDTH + j];
+						display.setCursorByPixel(i, j);
+						display.writeByte(byte);
+						written++;
 					}
 				}
 			}
+			Metrics::addBytes(written);
 			return true;
 		}
 		
@@ -218,13 +285,13 @@ namespace OLED{
 				return 0;
 			}
 			else{
-				return SCREEN_WIDTH*NUM_ROWS;
+				return PANEL::BYTES;
 			}
 		}
 		
 		// drawImage: draws entire image using oledDraw -> this is very slow
-		bool drawImage(){
-			int status = oledDraw(this->buffer, this->size());
+		bool drawBasicImage(HAL::Display& display = HAL::display()){
+			int status = display.draw(this->buffer, this->size());
 			if(status == EXIT_FAILURE){
 				LOG::error("failed to draw image to oled");
 				return false;
@@ -233,40 +300,79 @@ namespace OLED{
 		}
 
 		// drawInclusiveBytes: draws pixels of oled including argument: include's pixels
-		bool drawInclusiveBytes(Image* include){ 
+		bool drawInclusiveBytes(BasicImage* include, HAL::Display& display = HAL::display()){ 
 			if(buffer == NULL){
-				LOG::warning("failed to draw image using raw bytes: buffer was deleted");
+				LOG_WARNING(DRAW_BYTES_DELETED);
 				return false;
 			}
-			for(int i = 0; i < NUM_ROWS; i++){
-				for(int j = 0; j < SCREEN_WIDTH; j++){
-					uint8_t byte = buffer[i*SCREEN_WIDTH + j];
-					byte = byte | include->buffer[i*SCREEN_WIDTH + j];
+			uint32_t written = 0;
+			for(int i = 0; i < PANEL::ROWS; i++){
+				int start = dirtyStart[i] < include->dirtyStart[i] ? dirtyStart[i] : include->dirtyStart[i];
+				int end = dirtyEnd[i] > include->dirtyEnd[i] ? dirtyEnd[i] : include->dirtyEnd[i];
+				for(int j = start; j < end; j++){
+					uint8_t byte = buffer[i*PANEL::WIDTH + j];
+					byte = byte | include->buffer[i*PANEL::WIDTH + j];
 					if(byte > 0){
-						oledSetCursorByPixel(i, j);
-						oledWriteByte(byte);
+						display.setCursorByPixel(i, j);
+						display.writeByte(byte);
+						written++;
 					}
 				}
 			}
+			Metrics::addBytes(written);
 
 			return true;
 		}
 
+		// markDirty: widens row's dirty columns to cover columns start up to end
+		void markDirty(unsigned row, unsigned start, unsigned end){
+			if((int)start < dirtyStart[row]){
+				dirtyStart[row] = start;
+			}
+			if((int)end > dirtyEnd[row]){
+				dirtyEnd[row] = end;
+			}
+		}
+
+		// markClean: empties the dirty columns of every row, the buffer must be zero
+		void markClean(){
+			for(int i = 0; i < PANEL::ROWS; i++){
+				dirtyStart[i] = PANEL::WIDTH;
+				dirtyEnd[i] = 0;
+			}
+		}
+
+		// markAll: makes every column of every row dirty
+		void markAll(){
+			for(int i = 0; i < PANEL::ROWS; i++){
+				dirtyStart[i] = 0;
+				dirtyEnd[i] = PANEL::WIDTH;
+			}
+		}
+
 	private:
 		
 		uint8_t* buffer;	// Array of bytes representing image for oled expansion each byte represents eight
 								// vertical pixels in one column of one row of the oled expansion
+		int dirtyStart[PANEL::ROWS];	// First column of each row written since the image was last cleared
+		int dirtyEnd[PANEL::ROWS];		// Column after the last one written, a row with dirtyStart >= dirtyEnd is all zero
 	};
 
-	// DrawContext class: defines two buffers: one for clearing previous image and one for drawing next image
+	// BasicDrawContext class: defines two buffers for a PANEL sized screen: one for clearing previous image and one for drawing next image
 	// Call order: write data to current, clear previous (excluding overlap), draw current (including overlap), then swap buffers
-	class DrawContext{
+	template<typename PANEL>
+	class BasicDrawContext{
 	public:
-		DrawContext(){
-			mClearBuffer = OLED::Image();
-			mCurrentBuffer = OLED::Image();
+		BasicDrawContext() : mDisplay(&HAL::display()) {
+			mClearBuffer = BasicImage<PANEL>();
+			mCurrentBuffer = BasicImage<PANEL>();
+			mRing = NULL;
+		}
+		// Draws to display instead of the first display, for processes running several tables
+		BasicDrawContext(HAL::Display& display) : mDisplay(&display) {
+			mRing = NULL;
 		}
-		~DrawContext(){
+		~BasicDrawContext(){
 
 		}
 
@@ -282,13 +388,14 @@ namespace OLED{
 
 		// clear: clears the screen: clearing only the non shared bytes of the clear buffer and current buffer
 		bool clear(){ 
+			Metrics::ScopedPhase phase(Metrics::PHASE_CLEAR);
+			TRACE_SCOPE("DrawContext::clear");
 			// We xor the clear buffer with the current buffer than and it with the clear buffer this gives us a buffer of bits that need to be erased
-			OLED::Image clearBytes = (mClearBuffer ^ mCurrentBuffer) & mClearBuffer;
-			
-			bool good = clearBytes.clearExclusiveBytes(&mCurrentBuffer);
+			bool good = mDiffBuffer.writeDifference(mClearBuffer, mCurrentBuffer, mClearBuffer);
+			good = good && mDiffBuffer.clearExclusiveBytes(&mCurrentBuffer, *mDisplay);
 			
 			if(!good){
-				LOG::warning("failed to clear draw context: unDraw on clear buffer failed");
+				LOG_WARNING(CONTEXT_CLEAR_FAILED);
 				return false;
 			}
 			
@@ -302,40 +409,59 @@ namespace OLED{
 
 		// draw: draws the current buffer to the screen ignores bytes that were previously drawn
 		bool draw(){ 
+			Metrics::ScopedPhase phase(Metrics::PHASE_DRAW);
+			TRACE_SCOPE("DrawContext::draw");
 			// Removing bytes that were previously drawn 
-			OLED::Image drawBytes = (mClearBuffer ^ mCurrentBuffer) & mCurrentBuffer;
-			bool good = drawBytes.drawInclusiveBytes(&mCurrentBuffer);
+			bool good = mDiffBuffer.writeDifference(mClearBuffer, mCurrentBuffer, mCurrentBuffer);
+			good = good && mDiffBuffer.drawInclusiveBytes(&mCurrentBuffer, *mDisplay);
 			if(!good){
-				LOG::warning("failed to draw context: drawBytes on current buffer failed");
+				LOG_WARNING(CONTEXT_DRAW_FAILED);
 				return false;
 			}
+			if(mRing != NULL){
+				mRing->publish(mCurrentBuffer.buffer, mCurrentBuffer.size(), Metrics::nowMicros());
+			}
 			return true;
 		}
 
+		// publishTo: copies every drawn frame into ring for external viewers (see framebuffer.h), NULL stops publishing
+		void publishTo(Framebuffer::Ring* ring){
+			mRing = ring;
+		}
+
 		// swapBuffers: swaps the current buffer and the clear buffer than clears current buffer
 		void swapBuffers(){
 			uint8_t* tmp = mClearBuffer.buffer;
 			mClearBuffer.buffer = mCurrentBuffer.buffer;
 			mCurrentBuffer.buffer = tmp;
-			for(int i = 0; i < mCurrentBuffer.size(); i++){
-				mCurrentBuffer.buffer[i] = 0;
+			for(int i = 0; i < PANEL::ROWS; i++){
+				std::swap(mClearBuffer.dirtyStart[i], mCurrentBuffer.dirtyStart[i]);
+				std::swap(mClearBuffer.dirtyEnd[i], mCurrentBuffer.dirtyEnd[i]);
 			}
+			mCurrentBuffer.clear();
 		}
 
 	private:
-		OLED::Image mClearBuffer;		// Clear buffer stores pixel data of last frame is used for comparing to current frame to
-											// determine which pixels need to cleared and which pixels need to be drawn
-		OLED::Image mCurrentBuffer;		// Current buffer stores pixel data of current frame
+		BasicImage<PANEL> mClearBuffer;		// Clear buffer stores pixel data of last frame is used for comparing to current frame to
+												// determine which pixels need to cleared and which pixels need to be drawn
+		BasicImage<PANEL> mCurrentBuffer;	// Current buffer stores pixel data of current frame
+		BasicImage<PANEL> mDiffBuffer;		// Bytes to clear or draw, reused every frame so drawing never allocates
+		HAL::Display* mDisplay;				// Display the context draws to
+		Framebuffer::Ring* mRing;			// Ring drawn frames are published to, NULL if they aren't
 	};
 
+	// Image and DrawContext of the panel the game is built for
+	typedef BasicImage<GamePanel> Image;
+	typedef BasicDrawContext<GamePanel> DrawContext;
+
 	// init: initialises oled expansion
-	bool init(){
-		int status = oledSetDisplayPower(1);
+	bool init(HAL::Display& display = HAL::display()){
+		int status = display.setPower(1);
 		if(status == EXIT_FAILURE){
 			LOG::error("failed to power oled on");
 			return false;
 		}
-		status = oledDriverInit();
+		status = display.init();
 		if(status == EXIT_FAILURE){
 			LOG::error("failed to initialize oled driver");
 			return false;
@@ -344,11 +470,12 @@ namespace OLED{
 	}
 
 	// quickClear: draws whitespace charecter to entire screen: is still far too slow to update the game at a reasonable refresh rate
-	bool quickClear(){ 
-		oledSetCursor(0, 0);
-		for(int i = 0; i < 21*8; i++){
-			oledWriteChar(' ');
+	bool quickClear(HAL::Display& display = HAL::display()){ 
+		display.setCursor(0, 0);
+		for(int i = 0; i < (SCREEN_WIDTH/6)*NUM_ROWS; i++){
+			display.writeChar(' ');
 		}
+		return true;
 	}
 }
 
@@ -0,0 +1,136 @@
+/*///////////////////////////////////////
+// realtime.h: This file contains the optional
+// real-time profile (motionPong --realtime),
+// echo widths are timed by polling in user
+// space so a sensor thread preempted during a
+// reading turns straight into a distance
+// error, with the profile on sensor threads
+// run under SCHED_FIFO above the render and
+// logging threads, memory is locked and each
+// thread's stack is pre-faulted
+//
+// Needs root or CAP_SYS_NICE and
+// CAP_IPC_LOCK, the game keeps running with
+// normal scheduling if the kernel refuses
+*/
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <errno.h>
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace Realtime{
+
+	// Thread roles of the profile, highest priority first
+	enum Role{
+		ROLE_SENSOR,	// Sensor worker threads timing echoes
+		ROLE_RENDER,	// Game loop: update, draw and display bus traffic
+		ROLE_LOG		// Log writer thread
+	};
+
+	const int SENSOR_PRIORITY = 80;				// SCHED_FIFO priority of sensor threads
+	const int RENDER_PRIORITY = 40;				// SCHED_FIFO priority of the game loop
+	const int LOG_PRIORITY = 1;					// SCHED_FIFO priority of the log writer, only above normal threads
+	const int PREFAULT_STACK_SIZE = 64*1024;	// Stack bytes touched by apply so page faults happen before the first frame
+	const int SENSOR_CPUS = 2;					// CPUs kept for sensor threads, from the last one down, if there are more
+
+	// State: profile switch and the next CPU handed to a sensor thread
+	struct State{
+		std::atomic<bool> enabled;
+		std::atomic<int> nextSensor;
+	};
+
+	State& state(){
+		static State instance = {{false}, {0}};
+		return instance;
+	}
+
+	bool enabled(){
+		return state().enabled.load(std::memory_order_relaxed);
+	}
+
+	// cpuCount: online CPUs, 1 on the Omega 2
+	int cpuCount(){
+		long count = sysconf(_SC_NPROCESSORS_ONLN);
+		return count < 1 ? 1 : (int)count;
+	}
+
+	// enable: turns the profile on for threads that call apply from now on and locks current and future memory,
+	// returns false with errno set if memory couldn't be locked
+	bool enable(){
+		state().enabled.store(true);
+		state().nextSensor.store(0);
+		return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+	}
+
+	// disable: turns the profile off for threads that call apply from now on and unlocks memory
+	void disable(){
+		state().enabled.store(false);
+		munlockall();
+	}
+
+	// prefaultStack: touches PREFAULT_STACK_SIZE bytes of the calling thread's stack
+	__attribute__((noinline)) void prefaultStack(){
+		volatile char stack[PREFAULT_STACK_SIZE];
+		for(int i = 0; i < PREFAULT_STACK_SIZE; i += 4096){
+			stack[i] = 0;
+		}
+		// Uses the stack so the stores are kept and the compiler doesn't warn that it is only set
+		asm volatile("" : : "r"(stack) : "memory");
+	}
+
+	// sensorCpus: CPUs kept for sensor threads, at least one CPU is left for the others
+	int sensorCpus(){
+		int count = cpuCount();
+		return count - 1 < SENSOR_CPUS ? count - 1 : SENSOR_CPUS;
+	}
+
+	// pin: restricts calling thread to the next sensor CPU, or for other roles to the CPUs sensors don't use
+	bool pin(Role role){
+		int count = cpuCount();
+		int reserved = sensorCpus();
+		if(reserved == 0){
+			return true;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if(role == ROLE_SENSOR){
+			CPU_SET(count - 1 - state().nextSensor.fetch_add(1)%reserved, &set);
+		}
+		else{
+			for(int i = 0; i < count - reserved; i++){
+				CPU_SET(i, &set);
+			}
+		}
+		int status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if(status != 0){
+			errno = status;
+			return false;
+		}
+		return true;
+	}
+
+	// apply: moves calling thread to role's SCHED_FIFO priority and CPUs and pre-faults its stack, does nothing while
+	// the profile is off, returns false with errno set if the kernel refused (thread keeps normal scheduling)
+	bool apply(Role role){
+		if(!enabled()){
+			return true;
+		}
+		prefaultStack();
+		struct sched_param param;
+		param.sched_priority = role == ROLE_SENSOR ? SENSOR_PRIORITY : role == ROLE_RENDER ? RENDER_PRIORITY : LOG_PRIORITY;
+		int status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(status != 0){
+			errno = status;
+			return false;
+		}
+		return pin(role);
+	}
+}
+
+#endif // REALTIME_H
@@ -0,0 +1,236 @@
+/*///////////////////////////////////////
+// recorder.h: This file contains an in-memory
+// flight recorder, the game records timings,
+// sensor samples and ball state of recent
+// frames into a fixed-size circular buffer
+// which is only written to disk when the game
+// crashes, is terminated, receives SIGUSR1 or
+// aborts with an error
+*/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace Recorder{
+
+	const char DEFAULT_PATH[] = "flight.rec";
+	const int FRAME_COUNT = 512;	// Frames kept, about 10 seconds of play
+	const int PATH_SIZE = 256;
+
+	// FrameRecord: state of one frame
+	struct FrameRecord{
+		uint32_t frame;				// Frame number
+		uint32_t start;				// Frame start time in microseconds
+		uint32_t updateMicros;		// Time spent in update
+		uint32_t drawMicros;		// Time spent in draw including sensor waits
+		uint32_t bytes;				// Bytes written to the display
+		float distance1;			// Sensor sample of paddle 1 in metres, NaN if none
+		float distance2;			// Sensor sample of paddle 2 in metres, NaN if none
+		float paddle1;				// Paddle 1 x position
+		float paddle2;				// Paddle 2 x position
+		float ballX;				// Ball position
+		float ballY;
+		float ballVelocityX;		// Ball velocity
+		float ballVelocityY;
+		uint8_t state;				// Round state
+		uint8_t score1;				// Player 1 score
+		uint8_t score2;				// Player 2 score
+	};
+
+	// Recording: circular buffer of frames and dump path, written by the game thread only
+	struct Recording{
+		FrameRecord frames[FRAME_COUNT];
+		std::atomic<uint32_t> count;	// Frames committed so far
+		char path[PATH_SIZE];			// File written by dump
+	};
+
+	Recording& recording(){
+		static Recording instance;
+		return instance;
+	}
+
+	// begin: returns slot for the next frame, fill it in then call commit
+	FrameRecord& begin(){
+		Recording& rec = recording();
+		uint32_t count = rec.count.load(std::memory_order_relaxed);
+		FrameRecord& record = rec.frames[count % FRAME_COUNT];
+		record.frame = count;
+		return record;
+	}
+
+	// commit: makes slot returned by begin part of the recording
+	void commit(){
+		Recording& rec = recording();
+		rec.count.store(rec.count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// appendString: async-signal-safe string append, returns new length
+	int appendString(char* buffer, int length, const char* string){
+		while(*string != '\0'){
+			buffer[length++] = *string++;
+		}
+		return length;
+	}
+
+	// appendInt: async-signal-safe integer append
+	int appendInt(char* buffer, int length, long value){
+		char digits[24];
+		int count = 0;
+		bool negative = value < 0;
+		unsigned long magnitude = negative ? -(unsigned long)value : (unsigned long)value;
+		do{
+			digits[count++] = '0' + magnitude%10;
+			magnitude /= 10;
+		}
+		while(magnitude > 0);
+		if(negative){
+			buffer[length++] = '-';
+		}
+		while(count > 0){
+			buffer[length++] = digits[--count];
+		}
+		return length;
+	}
+
+	// appendFloat: async-signal-safe append of value with 3 decimals, NaN is written as nan
+	int appendFloat(char* buffer, int length, float value){
+		if(value != value){
+			return appendString(buffer, length, "nan");
+		}
+		long scaled = (long)(value*1000.0f + (value < 0 ? -0.5f : 0.5f));
+		if(scaled < 0){
+			buffer[length++] = '-';
+			scaled = -scaled;
+		}
+		length = appendInt(buffer, length, scaled/1000);
+		buffer[length++] = '.';
+		long fraction = scaled%1000;
+		buffer[length++] = '0' + fraction/100;
+		buffer[length++] = '0' + (fraction/10)%10;
+		buffer[length++] = '0' + fraction%10;
+		return length;
+	}
+
+	// writeAll: async-signal-safe write of length bytes
+	void writeAll(int fd, const char* buffer, int length){
+		int offset = 0;
+		while(offset < length){
+			ssize_t written = write(fd, buffer + offset, length - offset);
+			if(written <= 0){
+				return;
+			}
+			offset += written;
+		}
+	}
+
+	// dump: writes recorded frames oldest first to the dump path, async-signal-safe so it can run in a signal handler
+	void dump(const char* reason){
+		Recording& rec = recording();
+		int fd = open(rec.path[0] != '\0' ? rec.path : DEFAULT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0){
+			return;
+		}
+		uint32_t count = rec.count.load(std::memory_order_acquire);
+		uint32_t first = count > (uint32_t)FRAME_COUNT ? count - FRAME_COUNT : 0;
+		char line[512];
+		int length = appendString(line, 0, "motionPong flight recorder: ");
+		length = appendString(line, length, reason);
+		length = appendString(line, length, " pid: ");
+		length = appendInt(line, length, getpid());
+		length = appendString(line, length, " frames: ");
+		length = appendInt(line, length, count - first);
+		length = appendString(line, length, " of ");
+		length = appendInt(line, length, count);
+		line[length++] = '\n';
+		writeAll(fd, line, length);
+		for(uint32_t i = first; i < count; i++){
+			const FrameRecord& record = rec.frames[i % FRAME_COUNT];
+			length = appendString(line, 0, "frame=");
+			length = appendInt(line, length, record.frame);
+			length = appendString(line, length, " t=");
+			length = appendInt(line, length, record.start);
+			length = appendString(line, length, "us update=");
+			length = appendInt(line, length, record.updateMicros);
+			length = appendString(line, length, "us draw=");
+			length = appendInt(line, length, record.drawMicros);
+			length = appendString(line, length, "us bytes=");
+			length = appendInt(line, length, record.bytes);
+			length = appendString(line, length, " sensor1=");
+			length = appendFloat(line, length, record.distance1);
+			length = appendString(line, length, " sensor2=");
+			length = appendFloat(line, length, record.distance2);
+			length = appendString(line, length, " paddle1=");
+			length = appendFloat(line, length, record.paddle1);
+			length = appendString(line, length, " paddle2=");
+			length = appendFloat(line, length, record.paddle2);
+			length = appendString(line, length, " ball=(");
+			length = appendFloat(line, length, record.ballX);
+			length = appendString(line, length, ", ");
+			length = appendFloat(line, length, record.ballY);
+			length = appendString(line, length, ") velocity=(");
+			length = appendFloat(line, length, record.ballVelocityX);
+			length = appendString(line, length, ", ");
+			length = appendFloat(line, length, record.ballVelocityY);
+			length = appendString(line, length, ") state=");
+			length = appendInt(line, length, record.state);
+			length = appendString(line, length, " score=");
+			length = appendInt(line, length, record.score1);
+			line[length++] = '-';
+			length = appendInt(line, length, record.score2);
+			line[length++] = '\n';
+			writeAll(fd, line, length);
+		}
+		close(fd);
+	}
+
+	// handleSignal: dumps recording, SIGUSR1 lets the game continue, fatal signals are re-raised with the default action
+	void handleSignal(int signal){
+		int saved = errno;
+		switch(signal){
+		case SIGSEGV:
+			dump("SIGSEGV");
+			break;
+		case SIGABRT:
+			dump("SIGABRT");
+			break;
+		case SIGTERM:
+			dump("SIGTERM");
+			break;
+		default:
+			dump("SIGUSR1");
+			errno = saved;
+			return;
+		}
+		// Fatal handlers are installed with SA_RESETHAND so this runs the default action
+		raise(signal);
+	}
+
+	// install: sets dump path and installs signal handlers for SIGSEGV, SIGABRT, SIGTERM and SIGUSR1
+	bool install(const char* path = DEFAULT_PATH){
+		Recording& rec = recording();
+		strncpy(rec.path, path, PATH_SIZE - 1);
+		rec.path[PATH_SIZE - 1] = '\0';
+
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = handleSignal;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+		bool good = sigaction(SIGUSR1, &action, NULL) == 0;
+		action.sa_flags = SA_RESETHAND;
+		good = good && sigaction(SIGSEGV, &action, NULL) == 0;
+		good = good && sigaction(SIGABRT, &action, NULL) == 0;
+		good = good && sigaction(SIGTERM, &action, NULL) == 0;
+		return good;
+	}
+}
+
+#endif // RECORDER_H
@@ -0,0 +1,151 @@
+/*///////////////////////////////////////
+// scheduler.h: This file contains the table
+// scheduler, runs several independent pong
+// tables in one process (motionPong --tables)
+// each with its own sensor pins, display and
+// game state, sensor reads of every table
+// share one sampler pool and the tables are
+// stepped round-robin by a few render threads
+// so thread count follows the CPUs rather
+// than the number of tables
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "motionPong.h"
+
+#include <csignal>
+
+const int MAX_TABLES = 8;	// Tables one process can run
+
+// Sensor pins of each table, table 0 is wired as in the report and the others take four consecutive pins from 24
+const PinMap TABLE_PINS[MAX_TABLES] = {
+	DEFAULT_PINS,
+	{24, 25, 26, 27},
+	{28, 29, 30, 31},
+	{32, 33, 34, 35},
+	{36, 37, 38, 39},
+	{40, 41, 42, 43},
+	{44, 45, 46, 47},
+	{48, 49, 50, 51}
+};
+
+// class TableScheduler: owns the tables, the sampler pool shared by their sensors and the render threads stepping them
+class TableScheduler{
+public:
+	// TableScheduler: creates tables tables of game-mode mode, table i draws to HAL::display(i)
+	TableScheduler(Gamemode mode, int tables){
+		if(tables < 1 || tables > MAX_TABLES || tables > HAL::MAX_DISPLAYS){
+			int limit = MAX_TABLES < HAL::MAX_DISPLAYS ? MAX_TABLES : HAL::MAX_DISPLAYS;
+			throw std::runtime_error(LOG::error(std::string("cannot run ") + std::to_string(tables) + " tables, this build supports 1 to " + std::to_string(limit)));
+		}
+		mTableCount = tables;
+		for(int i = 0; i < mTableCount; i++){
+			mTables[i] = new MotionPong(mode, TABLE_PINS[i], HAL::display(i));
+			mTables[i]->publishFrames(Framebuffer::ring(i));
+			mFrames[i] = 0;
+		}
+		int cpus = Realtime::cpuCount();
+		// Each table reads up to two sensors at once, reads poll the echo pin so threads beyond the CPU count only
+		// compete with each other
+		mSampler.start(2*mTableCount < cpus ? 2*mTableCount : cpus);
+		mRenderCount = mTableCount < cpus ? mTableCount : cpus;
+	}
+	~TableScheduler(){
+		// Queued reads are completed before the sensors they point to are freed
+		mSampler.stop();
+		for(int i = 0; i < mTableCount; i++){
+			delete mTables[i];
+		}
+	}
+
+	// init: brings up every table, sensors are sampled on the shared pool
+	void init(){
+		for(int i = 0; i < mTableCount; i++){
+			mTables[i]->useSampler(&mSampler);
+			mTables[i]->init();
+		}
+		LOG::message(std::string("running ") + std::to_string(mTableCount) + " tables on " + std::to_string(mRenderCount) + " render and " + std::to_string(mSampler.threads()) + " sampler threads");
+	}
+
+	// run: steps every table until all have closed, interrupted is set or each table drew maxFrames (0 for no limit),
+	// with serveImmediately rounds skip the ready-check and countdown so every frame is a playing frame
+	template<Gamemode MODE>
+	void run(volatile sig_atomic_t& interrupted, long maxFrames = 0, bool serveImmediately = false){
+		for(int i = 0; i < mTableCount; i++){
+			mTables[i]->reset<MODE>();
+			mFrames[i] = 0;
+		}
+		std::thread renderers[MAX_TABLES];
+		for(int r = 0; r < mRenderCount; r++){
+			renderers[r] = std::thread(&TableScheduler::render<MODE>, this, r, &interrupted, maxFrames, serveImmediately);
+		}
+		for(int r = 0; r < mRenderCount; r++){
+			renderers[r].join();
+		}
+	}
+
+	// frames: frames drawn by table since the last run started
+	long frames(int table) const{
+		return mFrames[table];
+	}
+
+	MotionPong& table(int index){
+		return *mTables[index];
+	}
+
+	int tables() const{
+		return mTableCount;
+	}
+
+	int renderThreads() const{
+		return mRenderCount;
+	}
+
+private:
+	// render: render thread renderer steps one frame of each of its tables in turn, tables are dealt to render threads
+	// by index modulo the render thread count
+	template<Gamemode MODE>
+	void render(int renderer, volatile sig_atomic_t* interrupted, long maxFrames, bool serveImmediately){
+		if(!Realtime::apply(Realtime::ROLE_RENDER)){
+			LOG_WARNING(REALTIME_FAILED, (int)Realtime::ROLE_RENDER, errno);
+		}
+		bool running = true;
+		while(running && !*interrupted){
+			running = false;
+			for(int i = renderer; i < mTableCount; i += mRenderCount){
+				MotionPong& pongGame = *mTables[i];
+				if(pongGame.shouldClose() || (maxFrames > 0 && mFrames[i] >= maxFrames)){
+					continue;
+				}
+				running = true;
+				Metrics::ScopedPhase frame(Metrics::PHASE_FRAME);
+				if(serveImmediately && pongGame.roundState() != ROUND_PLAYING){
+					pongGame.enterState(ROUND_SERVE);
+				}
+				bool good;
+				{
+					Metrics::ScopedPhase phase(Metrics::PHASE_UPDATE);
+					good = pongGame.update<MODE>();
+				}
+				if(!good){
+					LOG_WARNING(UPDATE_FAILED);
+				}
+				if(!pongGame.draw<MODE>()){
+					LOG_WARNING(DRAW_FAILED);
+				}
+				Metrics::endFrame();
+				mFrames[i]++;
+			}
+		}
+	}
+
+	int mTableCount;						// Tables run
+	int mRenderCount;						// Render threads, one per table up to the CPU count
+	MotionPong* mTables[MAX_TABLES];		// Tables, allocated once when the scheduler is created
+	long mFrames[MAX_TABLES];				// Frames drawn by each table, only written by the table's render thread
+	Ultrasonic::SamplerPool mSampler;		// Threads taking sensor reads for every table
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,129 @@
+/*///////////////////////////////////////
+// logDecode: decodes binary log records
+// written to runtime.blog by the LOG_* macros
+// into text using the format table in
+// logformats.h, builds on the host without
+// the Omega libraries
+//
+// usage: logDecode [file] -> defaults to runtime.blog
+*/
+
+#include "logformats.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <iostream>
+
+#define LOG_FORMAT_STRING(id, level, format) format,
+const char* FORMATS[] = { LOG_FORMATS(LOG_FORMAT_STRING) };
+#undef LOG_FORMAT_STRING
+
+const char* LEVEL_NAMES[] = {"NONE", "ERROR", "WARNING", "MESSAGE", "DEBUG"};
+
+// formatRecord: substitutes raw arguments into format, each conversion consumes one 8 byte argument
+std::string formatRecord(const char* format, const uint8_t* args, int argCount){
+	std::string text;
+	int arg = 0;
+	while(*format != '\0'){
+		if(*format != '%'){
+			text += *format++;
+			continue;
+		}
+		if(format[1] == '%'){
+			text += '%';
+			format += 2;
+			continue;
+		}
+		// Copy conversion specification without its conversion character
+		std::string spec;
+		spec += *format++;
+		while(*format != '\0' && strchr("diuxXfFgGeE", *format) == NULL){
+			spec += *format++;
+		}
+		char conversion = *format;
+		if(conversion == '\0'){
+			break;
+		}
+		format++;
+		if(arg >= argCount){
+			text += "<missing>";
+			continue;
+		}
+		char buffer[64];
+		if(strchr("fFgGeE", conversion) != NULL){
+			double value;
+			memcpy(&value, args + arg*LOG::RECORD_ARG_SIZE, sizeof(value));
+			snprintf(buffer, sizeof(buffer), (spec + conversion).data(), value);
+		}
+		else{
+			long long value;
+			memcpy(&value, args + arg*LOG::RECORD_ARG_SIZE, sizeof(value));
+			if(conversion == 'd' || conversion == 'i'){
+				snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).data(), value);
+			}
+			else{
+				snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).data(), (unsigned long long)value);
+			}
+		}
+		text += buffer;
+		arg++;
+	}
+	return text;
+}
+
+int main(int argc, char* argv[]){
+	const char* path = argc > 1 ? argv[1] : "runtime.blog";
+	FILE* file = fopen(path, "rb");
+	if(file == NULL){
+		std::cerr << "failed to open binary log: " << path << std::endl;
+		return -1;
+	}
+
+	time_t sessionStart = 0;
+	uint8_t header[LOG::RECORD_HEADER_SIZE];
+	uint8_t args[LOG::MAX_ARGS*LOG::RECORD_ARG_SIZE];
+	while(fread(header, sizeof(header), 1, file) == 1){
+		uint16_t id;
+		uint32_t millis;
+		memcpy(&id, header, 2);
+		int argCount = header[2];
+		int level = header[3];
+		memcpy(&millis, header + 4, 4);
+		if(argCount > LOG::MAX_ARGS || fread(args, LOG::RECORD_ARG_SIZE, argCount, file) != (size_t)argCount){
+			std::cerr << "truncated or corrupt record in: " << path << std::endl;
+			return -1;
+		}
+
+		if(id == LOG::FORMAT_SESSION){
+			int64_t values[3];
+			memcpy(values, args, sizeof(values));
+			if(argCount != 3 || values[0] != LOG::SESSION_MAGIC){
+				std::cerr << "bad session record, log was written with a different byte order" << std::endl;
+				return -1;
+			}
+			sessionStart = (time_t)values[1];
+			if(values[2] != LOG::FORMAT_COUNT){
+				std::cerr << "warning: log has " << values[2] << " formats, decoder has " << LOG::FORMAT_COUNT << std::endl;
+			}
+			printf("\n");
+			continue;
+		}
+
+		time_t seconds = sessionStart + millis/1000;
+		struct tm stamp;
+		localtime_r(&seconds, &stamp);
+		char clock[16];
+		strftime(clock, sizeof(clock), "%T", &stamp);
+		const char* levelName = level <= LOG_LEVEL_DEBUG ? LEVEL_NAMES[level] : "UNKNOWN";
+		if(id >= LOG::FORMAT_COUNT){
+			printf("(%s.%03u)[LOG][%s]: unknown format id %u\n", clock, millis%1000, levelName, id);
+			continue;
+		}
+		printf("(%s.%03u)[LOG][%s]: %s\n", clock, millis%1000, levelName, formatRecord(FORMATS[id], args, argCount).data());
+	}
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*///////////////////////////////////////
+// paddleClient: remote paddle controller
+// for testing motionPong --remote on one
+// machine, sweeps both paddles back and
+// forth sending packets at a fixed rate
+//
+// usage: paddleClient [--host address] [--port port] [--rate hz] [--seconds n]
+*/
+
+#include "network.h"
+
+#include <cmath>
+#include <thread>
+
+const float SWEEP_MIN = 0.05f; // 5cm
+const float SWEEP_MAX = 0.40f; // 40cm
+const float SWEEP_PERIOD = 2.0f; // Seconds for one sweep back and forth
+
+int main(int argc, char* argv[]){
+	std::string host = "127.0.0.1";
+	int port = Network::DEFAULT_PORT;
+	int rate = 100;
+	int seconds = 0;
+	for(int i = 1; i + 1 < argc; i += 2){
+		std::string arg(argv[i]);
+		if(arg == "--host"){
+			host = argv[i + 1];
+		}
+		else if(arg == "--port"){
+			port = atoi(argv[i + 1]);
+		}
+		else if(arg == "--rate"){
+			rate = atoi(argv[i + 1]);
+		}
+		else if(arg == "--seconds"){
+			seconds = atoi(argv[i + 1]);
+		}
+		else{
+			std::cerr << "usage: " << argv[0] << " [--host address] [--port port] [--rate hz] [--seconds n]" << std::endl;
+			return -1;
+		}
+	}
+	if(rate <= 0){
+		rate = 100;
+	}
+
+	Network::PaddleSender sender;
+	if(!sender.open(host.data(), (uint16_t)port)){
+		return -1;
+	}
+	std::cout << "sending paddle packets to " << host << ":" << port << " at " << rate << "Hz" << std::endl;
+
+	std::chrono::microseconds period(1000000/rate);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point next = start;
+	while(true){
+		std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+		if(seconds > 0 && elapsed.count() >= seconds){
+			break;
+		}
+		float phase = 2.0f*M_PI*elapsed.count()/SWEEP_PERIOD;
+		float middle = (SWEEP_MIN + SWEEP_MAX)/2;
+		float amplitude = (SWEEP_MAX - SWEEP_MIN)/2;
+		bool good = sender.send(0, middle + amplitude*sin(phase));
+		good = good && sender.send(1, middle + amplitude*cos(phase));
+		if(!good){
+			LOG::warning("failed to send paddle packet");
+		}
+		next += period;
+		std::this_thread::sleep_until(next);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*///////////////////////////////////////
+// pongStat: prints frame metrics published
+// by a running motionPong, reads the stats
+// file without locking so the game is never
+// paused, builds on the host without the
+// Omega libraries
+//
+// usage: pongStat [--file path] [--watch seconds]
+*/
+
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include <thread>
+
+// printHistogram: prints one row of percentiles, values are bucket upper bounds
+void printHistogram(const char* name, const Metrics::Histogram& histogram){
+	printf("%-14s %10u %10u %10u %10u %10u\n", name, histogram.count.load(), histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.max.load());
+}
+
+// printStats: prints all phases, bytes per frame, motion-to-photon latency and sensor NaN rate
+void printStats(const Metrics::Stats* stats, uint32_t frames, float elapsed){
+	printf("pid: %u frames: %u", stats->pid, stats->frames.load());
+	if(elapsed > 0){
+		printf(" fps: %.1f", frames/elapsed);
+	}
+	printf("\n%-14s %10s %10s %10s %10s %10s\n", "phase (us)", "count", "p50", "p90", "p99", "max");
+	for(int i = 0; i < Metrics::PHASE_COUNT; i++){
+		printHistogram(Metrics::PHASE_NAMES[i], stats->phases[i]);
+	}
+	printHistogram("bytes/frame", stats->frameBytes);
+	printHistogram("motion-photon", stats->motionToPhoton);
+	uint32_t samples = stats->sensorSamples.load();
+	uint32_t nans = stats->sensorNaNs.load();
+	printf("sensor samples: %u NaN: %u (%.1f%%)\n", samples, nans, samples > 0 ? 100.0f*nans/samples : 0.0f);
+}
+
+int main(int argc, char* argv[]){
+	std::string path = Metrics::DEFAULT_PATH;
+	int watch = 0;
+	for(int i = 1; i + 1 < argc; i += 2){
+		std::string arg(argv[i]);
+		if(arg == "--file"){
+			path = argv[i + 1];
+		}
+		else if(arg == "--watch"){
+			watch = atoi(argv[i + 1]);
+		}
+		else{
+			std::cerr << "usage: " << argv[0] << " [--file path] [--watch seconds]" << std::endl;
+			return -1;
+		}
+	}
+
+	const Metrics::Stats* stats = Metrics::map(path.data());
+	if(stats == NULL){
+		std::cerr << "no metrics published at: " << path << std::endl;
+		return -1;
+	}
+	printStats(stats, 0, 0);
+	while(watch > 0){
+		uint32_t frames = stats->frames.load();
+		std::this_thread::sleep_for(std::chrono::seconds(watch));
+		printf("\n");
+		printStats(stats, stats->frames.load() - frames, (float)watch);
+	}
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*///////////////////////////////////////
+// pongView: shows the frames a running
+// motionPong publishes (see framebuffer.h)
+// in the terminal and can record them, reads
+// frames in place from the shared ring so
+// the game never waits for the viewer, builds
+// on the host without the Omega libraries
+//
+// usage: pongView [--file path] [--table n] [--fps n] [--count n] [--record path]
+*/
+
+#include "framebuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include <thread>
+
+// Terminal cells for the pixel pairs above each other: neither, top, bottom, both
+const char* const CELLS[4] = {" ", "▀", "▄", "█"};
+
+// pixel: pixel (x, y) of a frame in the oled-exp page layout
+bool pixel(const uint8_t* pixels, int width, int x, int y){
+	return (pixels[(y/8)*width + x] >> (y%8)) & 1;
+}
+
+// render: draws pixels two rows per line into text
+void render(const uint8_t* pixels, int width, int pages, std::string& text){
+	text.clear();
+	for(int y = 0; y < pages*8; y += 2){
+		for(int x = 0; x < width; x++){
+			text += CELLS[pixel(pixels, width, x, y) | pixel(pixels, width, x, y + 1) << 1];
+		}
+		text += '\n';
+	}
+}
+
+int main(int argc, char* argv[]){
+	std::string path = Framebuffer::DEFAULT_PATH;
+	std::string recordPath;
+	int table = 0;
+	int fps = 10;
+	long count = 0;
+	for(int i = 1; i + 1 < argc; i += 2){
+		std::string arg(argv[i]);
+		if(arg == "--file"){
+			path = argv[i + 1];
+		}
+		else if(arg == "--table"){
+			table = atoi(argv[i + 1]);
+		}
+		else if(arg == "--fps"){
+			fps = atoi(argv[i + 1]);
+		}
+		else if(arg == "--count"){
+			count = atol(argv[i + 1]);
+		}
+		else if(arg == "--record"){
+			recordPath = argv[i + 1];
+		}
+		else{
+			std::cerr << "usage: " << argv[0] << " [--file path] [--table n] [--fps n] [--count n] [--record path]" << std::endl;
+			return -1;
+		}
+	}
+	if(argc%2 == 0 || fps < 1){
+		std::cerr << "usage: " << argv[0] << " [--file path] [--table n] [--fps n] [--count n] [--record path]" << std::endl;
+		return -1;
+	}
+
+	const Framebuffer::Frames* frames = Framebuffer::map(path.data());
+	if(frames == NULL){
+		std::cerr << "no frames published at: " << path << std::endl;
+		return -1;
+	}
+	// Read once, map checked the frame fits a slot but a restarted game rewrites the header
+	int width = frames->width;
+	int pages = frames->pages;
+	if(width <= 0 || pages <= 0 || pages > Framebuffer::MAX_FRAME_BYTES/width){
+		std::cerr << "frames of " << width << "x" << pages << " pages don't fit a slot" << std::endl;
+		return -1;
+	}
+	if(table < 0 || table >= (int)frames->rings){
+		std::cerr << "table must be below " << frames->rings << std::endl;
+		return -1;
+	}
+	FILE* record = NULL;
+	if(!recordPath.empty()){
+		record = fopen(recordPath.data(), "wb");
+		if(record == NULL){
+			std::cerr << "failed to open recording: " << recordPath << std::endl;
+			return -1;
+		}
+	}
+
+	// A recording starts with the frame size followed by (frame number, micros, pixels) per frame shown
+	if(record != NULL){
+		uint32_t header[2] = {(uint32_t)width, (uint32_t)pages};
+		fwrite(header, sizeof(header), 1, record);
+	}
+	const Framebuffer::Ring& ring = frames->ring[table];
+	std::string text;
+	uint32_t lastFrame = 0;
+	bool shown = false;
+	long dropped = 0;
+	for(long i = 0; count == 0 || i < count; i++){
+		uint32_t sequence;
+		const Framebuffer::Slot* slot = Framebuffer::latest(ring, sequence);
+		if(slot == NULL || (shown && slot->frame == lastFrame)){
+			// No new frame yet, try again shortly instead of waiting a whole period
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			i--;
+			continue;
+		}
+		uint32_t frame = slot->frame;
+		uint32_t micros = slot->micros;
+		render(slot->pixels, width, pages, text);
+		if(!Framebuffer::unchanged(slot, sequence)){
+			// Game overwrote the slot while it was read
+			i--;
+			continue;
+		}
+		if(record != NULL){
+			// Copied from the slot again, the recorded pixels must match the frame that was rendered
+			uint8_t pixels[Framebuffer::MAX_FRAME_BYTES];
+			memcpy(pixels, slot->pixels, width*pages);
+			if(Framebuffer::unchanged(slot, sequence)){
+				uint32_t stamp[2] = {frame, micros};
+				fwrite(stamp, sizeof(stamp), 1, record);
+				fwrite(pixels, width*pages, 1, record);
+			}
+		}
+		if(shown){
+			dropped += frame - lastFrame - 1;
+		}
+		lastFrame = frame;
+		shown = true;
+		printf("\033[H\033[2Jpid: %u table: %d frame: %u skipped: %ld\n%s", frames->pid, table, frame, dropped, text.data());
+		fflush(stdout);
+		std::this_thread::sleep_for(std::chrono::microseconds(1000000/fps));
+	}
+	if(record != NULL){
+		fclose(record);
+	}
+	return 0;
+}
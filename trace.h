@@ -0,0 +1,225 @@
+/*///////////////////////////////////////
+// trace.h: This file contains a scoped
+// trace-event profiler, TRACE_SCOPE records
+// the start and duration of a scope into a
+// per-thread buffer and Trace::stop writes
+// every buffer out as Chrome trace-event JSON
+// which loads in Perfetto or chrome://tracing
+//
+// Scopes are compiled in when TRACE is defined
+// and only record while tracing is started
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+namespace Trace{
+
+	const int MAX_BUFFERS = 32;				// Maximum number of thread buffers, threads beyond this are not traced
+	const int EVENTS_PER_BUFFER = 8192;		// Events each buffer holds, later events are dropped
+	const int THREAD_NAME_SIZE = 32;
+
+	// Event: one completed scope
+	struct Event{
+		const char* name;		// Scope name, must be a string literal
+		int64_t start;			// Start time in microseconds
+		uint32_t duration;		// Duration in microseconds
+		uint32_t tid;			// Thread that recorded the event
+	};
+
+	// Buffer: events of one thread at a time, released for reuse when its thread exits
+	// (sensor worker threads of a finished game or benchmark are replaced by new ones)
+	struct Buffer{
+		std::atomic<bool> inUse;
+		std::atomic<uint32_t> count;		// Events written, published with release
+		std::atomic<uint32_t> dropped;		// Events dropped because buffer was full
+		Event events[EVENTS_PER_BUFFER];
+	};
+
+	// ThreadName: name given to a thread with nameThread, emitted as metadata
+	struct ThreadName{
+		uint32_t tid;
+		char name[THREAD_NAME_SIZE];
+	};
+
+	// Registry: all buffers ever allocated and tracing state
+	struct Registry{
+		std::atomic<bool> enabled;
+		std::atomic<Buffer*> buffers[MAX_BUFFERS];
+		ThreadName names[MAX_BUFFERS];
+		std::atomic<int> nameCount;
+	};
+
+	Registry& registry(){
+		static Registry instance;
+		return instance;
+	}
+
+	// enabled: true while tracing is started, this load is all a disabled scope costs
+	bool enabled(){
+		return registry().enabled.load(std::memory_order_relaxed);
+	}
+
+	// nowMicros: monotonic clock in microseconds
+	int64_t nowMicros(){
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// acquireBuffer: takes a free buffer or allocates a new one, returns NULL if all slots are taken
+	Buffer* acquireBuffer(){
+		Registry& reg = registry();
+		for(int i = 0; i < MAX_BUFFERS; i++){
+			Buffer* buffer = reg.buffers[i].load(std::memory_order_acquire);
+			if(buffer == NULL){
+				Buffer* created = new Buffer();
+				created->inUse.store(true);
+				created->count.store(0);
+				created->dropped.store(0);
+				if(reg.buffers[i].compare_exchange_strong(buffer, created, std::memory_order_acq_rel)){
+					return created;
+				}
+				delete created;
+			}
+			bool free = false;
+			if(buffer != NULL && buffer->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)){
+				return buffer;
+			}
+		}
+		return NULL;
+	}
+
+	// ThreadSlot: buffer held by the current thread, returned to the registry when the thread exits
+	struct ThreadSlot{
+		ThreadSlot(){
+			buffer = NULL;
+			tid = (uint32_t)syscall(SYS_gettid);
+		}
+		~ThreadSlot(){
+			if(buffer != NULL){
+				buffer->inUse.store(false, std::memory_order_release);
+			}
+		}
+		Buffer* buffer;
+		uint32_t tid;
+	};
+
+	ThreadSlot& threadSlot(){
+		static thread_local ThreadSlot slot;
+		return slot;
+	}
+
+	// record: appends event to current thread's buffer
+	void record(const char* name, int64_t start, uint32_t duration){
+		ThreadSlot& slot = threadSlot();
+		if(slot.buffer == NULL){
+			slot.buffer = acquireBuffer();
+			if(slot.buffer == NULL){
+				return;
+			}
+		}
+		Buffer* buffer = slot.buffer;
+		uint32_t index = buffer->count.load(std::memory_order_relaxed);
+		if(index >= (uint32_t)EVENTS_PER_BUFFER){
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Event& event = buffer->events[index];
+		event.name = name;
+		event.start = start;
+		event.duration = duration;
+		event.tid = slot.tid;
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	// nameThread: names current thread in the trace
+	void nameThread(const char* name){
+		Registry& reg = registry();
+		int index = reg.nameCount.fetch_add(1);
+		if(index >= MAX_BUFFERS){
+			return;
+		}
+		reg.names[index].tid = threadSlot().tid;
+		strncpy(reg.names[index].name, name, THREAD_NAME_SIZE - 1);
+		reg.names[index].name[THREAD_NAME_SIZE - 1] = '\0';
+	}
+
+	// start: enables recording
+	void start(){
+		registry().enabled.store(true, std::memory_order_relaxed);
+	}
+
+	// stop: disables recording and writes all events to path as trace-event JSON, returns false if the file cannot be written
+	bool stop(const char* path){
+		Registry& reg = registry();
+		reg.enabled.store(false, std::memory_order_relaxed);
+		FILE* file = fopen(path, "w");
+		if(file == NULL){
+			return false;
+		}
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		bool first = true;
+		uint32_t pid = (uint32_t)getpid();
+		int names = reg.nameCount.load();
+		for(int i = 0; i < names && i < MAX_BUFFERS; i++){
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, reg.names[i].tid, reg.names[i].name);
+			first = false;
+		}
+		uint32_t dropped = 0;
+		for(int i = 0; i < MAX_BUFFERS; i++){
+			Buffer* buffer = reg.buffers[i].load(std::memory_order_acquire);
+			if(buffer == NULL){
+				continue;
+			}
+			uint32_t count = buffer->count.load(std::memory_order_acquire);
+			for(uint32_t j = 0; j < count; j++){
+				const Event& event = buffer->events[j];
+				fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":%u,\"tid\":%u}", first ? "" : ",\n", event.name, (long long)event.start, event.duration, pid, event.tid);
+				first = false;
+			}
+			dropped += buffer->dropped.load();
+		}
+		fprintf(file, "\n],\"otherData\":{\"droppedEvents\":%u}}\n", dropped);
+		return fclose(file) == 0;
+	}
+
+	// class Scope: records an event from construction to destruction while tracing is enabled, use TRACE_SCOPE
+	class Scope{
+	public:
+		Scope(const char* name){
+			if(enabled()){
+				mName = name;
+				mStart = nowMicros();
+			}
+			else{
+				mName = NULL;
+			}
+		}
+		~Scope(){
+			if(mName != NULL){
+				record(mName, mStart, (uint32_t)(nowMicros() - mStart));
+			}
+		}
+
+	private:
+		const char* mName;		// Scope name or NULL if tracing was disabled at construction
+		int64_t mStart;			// Start time in microseconds
+	};
+}
+
+#endif // TRACE_H
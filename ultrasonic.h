@@ -7,10 +7,14 @@
 #define ULTRASONIC_H
 
 #include "oled.h"
+#include "gpioMap.h"
+#include "clock.h"
 
 #include <limits>
 #include <thread>
-#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 #include <chrono>
 
 #define US_ONE_TRIGGER 18
@@ -52,6 +56,7 @@ namespace Stats{
 			quicksortHelper<Type>(dataset, size, left, l2 - 1);
 			quicksortHelper<Type>(dataset, size, l2, right);
 		}
+		return true;
 	}
 
 	// A generic quicksort function
@@ -60,44 +65,76 @@ namespace Stats{
 		return quicksortHelper<Type>(dataset, size, 0, size - 1);
 	}
 
+	// A generic average function, sums in Type so fixed-point datasets stay in fixed-point
 	template<typename Type>
-	float average(Type dataset[], const int size){
+	Type average(Type dataset[], const int size){
 		if(size < 1){
 			return std::numeric_limits<Type>::quiet_NaN();
 		}
-		float sum = 0.0f;
+		Type sum = 0;
 		for(int i = 0; i < size; i++){
-			sum = sum + (float)dataset[i];
+			sum = sum + dataset[i];
 		}
 		return sum/size;
 	}
 
+	// integerSqrt: floor of square root of value
+	uint32_t integerSqrt(uint32_t value){
+		uint32_t root = 0;
+		uint32_t bit = 1u << 30;
+		while(bit > value){
+			bit >>= 2;
+		}
+		while(bit != 0){
+			if(value >= root + bit){
+				value -= root + bit;
+				root = (root >> 1) + bit;
+			}
+			else{
+				root >>= 1;
+			}
+			bit >>= 2;
+		}
+		return root;
+	}
+
+	// root: square root used by the generic functions, integer datasets stay in integers
+	template<typename Type>
+	Type root(Type value){
+		return sqrt(value);
+	}
+	int32_t root(int32_t value){
+		return value <= 0 ? 0 : (int32_t)integerSqrt((uint32_t)value);
+	}
+
 	// A generic sample standard deviation function
 	template<typename Type>
-	float sampleStandardDeviation(Type dataset[], const int size){
+	Type sampleStandardDeviation(Type dataset[], const int size){
 		if(size <= 1){
 			return std::numeric_limits<Type>::quiet_NaN();
 		}
-		float avg = average<Type>(dataset, size);
-		float sumOfDeviation = 0.0f;
+		Type avg = average<Type>(dataset, size);
+		Type sumOfDeviation = 0;
 		for(int i = 0; i < size; i++){
-			sumOfDeviation += pow((dataset[i] - avg), 2);
+			Type deviation = dataset[i] - avg;
+			sumOfDeviation += deviation*deviation;
 		}
-		return sqrt((1/((float)size - 1.0)) * sumOfDeviation);
+		return root(sumOfDeviation/(size - 1));
 	}
 
 	// A generic population standard deviation function
 	template<typename Type>
-	float populationStandardDeviation(Type dataset[], const int size){
+	Type populationStandardDeviation(Type dataset[], const int size){
 		if(size <= 1){
 			return std::numeric_limits<Type>::quiet_NaN();
 		}
-		float avg = average<Type>(dataset, size);
-		float sumOfDeviation = 0.0f;
+		Type avg = average<Type>(dataset, size);
+		Type sumOfDeviation = 0;
 		for(int i = 0; i < size; i++){
-			sumOfDeviation += pow((dataset[i] - avg), 2);
+			Type deviation = dataset[i] - avg;
+			sumOfDeviation += deviation*deviation;
 		}
-		return sqrt((1.0/(float)size) * sumOfDeviation);
+		return root(sumOfDeviation/size);
 	}
 }
 
@@ -110,6 +147,32 @@ namespace Ultrasonic{
 	const int INTERPOLATION_SAMPLES = 9;
 	const float SENSOR_TIMEOUT = (2*(MAX_DISTANCE + 1.0))/SPEED_OF_SOUND;
 
+	// Echo times are measured in whole microseconds so the paddle path stays integer after the timestamps are taken
+	const uint32_t SENSOR_TIMEOUT_MICROS = (uint32_t)(SENSOR_TIMEOUT*1000000);
+	const uint32_t MAX_ECHO_MICROS = (uint32_t)(2*MAX_DISTANCE/SPEED_OF_SOUND*1000000); // Echo time of MAX_DISTANCE
+	const uint32_t NO_ECHO = 0xFFFFFFFF;	// Reading that timed out or a remote paddle without a new sample
+	const int ECHO_QUANTUM = 4;				// Microseconds per ColumnTable entry, about 0.7mm or a fifth of a pixel
+	const int ECHO_TABLE_SIZE = MAX_ECHO_MICROS/ECHO_QUANTUM + 1;
+	const int STABLE_READINGS = 5;			// Consecutive readings that must agree before a sensor is ready
+	const uint32_t STABLE_ECHO_MICROS = 60;	// Largest spread of agreeing readings, about 1cm
+	const std::chrono::milliseconds SETTLE_TIMEOUT = std::chrono::milliseconds(1000); // Time a sensor may take to settle
+
+	// echoToDistance: converts echo time in microseconds to distance in metres
+	float echoToDistance(uint32_t micros){
+		return (SPEED_OF_SOUND*micros)/2000000.0f;
+	}
+
+	// distanceToEcho: converts distance in metres to echo time in microseconds, NaN becomes NO_ECHO
+	uint32_t distanceToEcho(float distance){
+		if(distance != distance){
+			return NO_ECHO;
+		}
+		if(distance <= 0){
+			return 0;
+		}
+		return (uint32_t)(distance*2000000.0f/SPEED_OF_SOUND);
+	}
+
 	// Interpolation function for ultrasonic sensor using multiple sensor samples
 	double interpolate(double data[INTERPOLATION_SAMPLES]){
 
@@ -118,6 +181,74 @@ namespace Ultrasonic{
 		return data[medianIndex];
 	}
 
+	// EchoSample: interpolated echo time and when it was captured, carried to the frame that draws it
+	struct EchoSample{
+		uint32_t echo;			// Echo time in microseconds or NO_ECHO
+		uint32_t captured;		// Metrics::nowMicros() when the median window's middle reading was taken
+	};
+
+	const int MAX_SAMPLER_THREADS = 8;		// Threads a SamplerPool can run
+	const int MAX_SAMPLER_REQUESTS = 32;	// Reads a SamplerPool can queue, one outstanding per sensor
+
+	class Sensor;
+
+	// class SamplerPool: threads shared by the sensors of several tables, each thread takes queued reads
+	// in the order they were launched instead of every sensor keeping its own worker
+	class SamplerPool{
+	public:
+		SamplerPool(){
+			mThreadCount = 0;
+			mHead = 0;
+			mCount = 0;
+			mStop = false;
+		}
+		~SamplerPool(){
+			stop();
+		}
+
+		// start: starts threads sampler threads, capped at MAX_SAMPLER_THREADS
+		void start(int threads){
+			mStop = false;
+			while(mThreadCount < threads && mThreadCount < MAX_SAMPLER_THREADS){
+				mThreads[mThreadCount++] = std::thread(&SamplerPool::loop, this);
+			}
+		}
+
+		// stop: finishes reads in progress, stops the threads and completes queued reads with NO_ECHO
+		void stop();
+
+		// request: queues a read of sensor, returns false if the queue is full
+		bool request(Sensor* sensor){
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if(mCount == MAX_SAMPLER_REQUESTS || mThreadCount == 0){
+					return false;
+				}
+				mQueue[(mHead + mCount)%MAX_SAMPLER_REQUESTS] = sensor;
+				mCount++;
+			}
+			mCondition.notify_one();
+			return true;
+		}
+
+		int threads() const{
+			return mThreadCount;
+		}
+
+	private:
+		// loop: takes queued reads until stop
+		void loop();
+
+		std::thread mThreads[MAX_SAMPLER_THREADS];		// Sampler threads, the first mThreadCount are running
+		int mThreadCount;
+		std::mutex mMutex;								// Guards the queue
+		std::condition_variable mCondition;				// Signals queued reads and stop
+		Sensor* mQueue[MAX_SAMPLER_REQUESTS];			// Ring buffer of sensors waiting for a read
+		int mHead;										// Oldest queued read
+		int mCount;										// Queued reads
+		bool mStop;										// Threads should exit
+	};
+
 	// class Sensor: defines methods for the HC-SR04 ultrasonic sensors.
 	class Sensor
 	{
@@ -125,162 +256,444 @@ namespace Ultrasonic{
 		Sensor(){
 			mTriggerPin = -1;
 			mEchoPin = -1;
+			mEchoRegister = NULL;
+			mEchoMask = 0;
+			mSampler = NULL;
+			resetWorkerState();
 		}
-		// Initialise ultrasonic sensors with trigger pin: trigpin and echo pin: echopin, sets err to true if fails
+		// Initialise ultrasonic sensors with trigger pin: trigpin and echo pin: echopin, sets err to true if fails, the cause
+		// is logged as a warning and the caller reports the error so the display isn't written while it is brought up
 		Sensor(bool& err, uint8_t trigpin, uint8_t echopin){
 			this->mTriggerPin = trigpin;
 			this->mEchoPin = echopin;
+			mEchoRegister = NULL;
+			mEchoMask = 0;
+			mSampler = NULL;
+			resetWorkerState();
 			LOG::message(std::string("initializing ultrasonic sensor with trigger pin: ") + std::to_string(mTriggerPin) + " and echo pin: " + std::to_string(mEchoPin));
-			gpio_free(mTriggerPin);
-			gpio_free(mEchoPin);
-			int request = gpio_is_requested(mTriggerPin);
+			HAL::Gpio::free(mTriggerPin);
+			HAL::Gpio::free(mEchoPin);
+			int request = HAL::Gpio::isRequested(mTriggerPin);
 			if(request < 0){
-				LOG::error(std::string("ultrasonic trigger gpio:") + std::to_string(mTriggerPin) + " already requested: ");
+				LOG::warning(std::string("ultrasonic trigger gpio:") + std::to_string(mTriggerPin) + " already requested: ");
 				err = true;
 				return;
 			}
 			else{
-				request = gpio_request(mTriggerPin, NULL);
+				request = HAL::Gpio::request(mTriggerPin);
 				if(request < 0){
-					LOG::error(std::string("failed to request ultrasonic trigger gpio: ") + std::to_string(mTriggerPin));
+					LOG::warning(std::string("failed to request ultrasonic trigger gpio: ") + std::to_string(mTriggerPin));
 					err = true;
 					return;
 				}
 			}
-			request = gpio_is_requested(mEchoPin);
+			request = HAL::Gpio::isRequested(mEchoPin);
 			if(request < 0){
-				LOG::error(std::string("ultrasonic echo gpio:") + std::to_string(mEchoPin) + " already requested: ");
+				LOG::warning(std::string("ultrasonic echo gpio:") + std::to_string(mEchoPin) + " already requested: ");
 				err = true;
 				return;
 			}
 			else{
-				request = gpio_request(mEchoPin, NULL);
+				request = HAL::Gpio::request(mEchoPin);
 				if(request < 0){
-					LOG::error(std::string("failed to request ultrasonic echo gpio:") + std::to_string(mEchoPin));
+					LOG::warning(std::string("failed to request ultrasonic echo gpio:") + std::to_string(mEchoPin));
 					err = true;
 					return;
 				}
 			}
 
-			int status = gpio_direction_output(mTriggerPin, 0);
+			int status = HAL::Gpio::directionOutput(mTriggerPin, 0);
 			if(status < 0){
-				LOG::error(std::string("failed to set ultrasonic trigger gpio as output: ") + std::to_string(mTriggerPin));
+				LOG::warning(std::string("failed to set ultrasonic trigger gpio as output: ") + std::to_string(mTriggerPin));
 				err = true;
 				return;
 			}
 
-			status = gpio_direction_input(mEchoPin);
+			status = HAL::Gpio::directionInput(mEchoPin);
 			if(status < 0){
-				LOG::error(std::string("failed to set ultrasonic echo gpio as input: ") + std::to_string(mEchoPin));
+				LOG::warning(std::string("failed to set ultrasonic echo gpio as input: ") + std::to_string(mEchoPin));
 				err = true;
 				return;
 			}
 
+			HAL::Gpio::pairSensor(mTriggerPin, mEchoPin);
+			mEchoRegister = GpioMap::dataRegister(mEchoPin);
+			mEchoMask = GpioMap::pinMask(mEchoPin);
 			err = false;
 		}
 
 		Sensor(const Sensor& sensor){
 			this->mTriggerPin = sensor.mTriggerPin;
 			this->mEchoPin = sensor.mEchoPin;
+			this->mEchoRegister = sensor.mEchoRegister;
+			this->mEchoMask = sensor.mEchoMask;
+			mSampler = NULL;
+			resetWorkerState();
 		}
 
 		~Sensor(){
-			
+			stopWorker();
 		}
 
-		// Needed because std::future's assignment operator is deleted
+		// Needed because the worker thread can't be copied, copies only take the pins
 		void operator=(const Sensor& sensor){
+			stopWorker();
 			this->mTriggerPin = sensor.mTriggerPin;
 			this->mEchoPin = sensor.mEchoPin;
+			this->mEchoRegister = sensor.mEchoRegister;
+			this->mEchoMask = sensor.mEchoMask;
 		}
 
 		// free: rees sensors gpios
 		void free(){
-			if (gpio_free(mTriggerPin) < 0 || gpio_free(mEchoPin) < 0)
+			stopWorker();
+			if (HAL::Gpio::free(mTriggerPin) < 0 || HAL::Gpio::free(mEchoPin) < 0)
 			{
-				LOG::warning("failed to free sensor gpio's");
+				LOG_WARNING(SENSOR_FREE_FAILED, mTriggerPin, mEchoPin);
 			}
 		}
 
-		// reading: takes sensor reading using chrono for timing to not be dependant on CPU clock
-		double reading(){
-			int status = gpio_direction_output(mTriggerPin, GPIOF_INIT_HIGH);
-			std::this_thread::sleep_for(std::chrono::microseconds(10));
-			status = status | gpio_direction_output(mTriggerPin, GPIOF_INIT_LOW);
+		// echoValue: level of the echo pin, a load from the mapped gpio registers if they were mapped when the sensor
+		// was created (see gpioMap.h) otherwise read through HAL::Gpio
+		int echoValue(){
+			if(mEchoRegister != NULL){
+				return (*mEchoRegister & mEchoMask) != 0;
+			}
+			return HAL::Gpio::getValue(mEchoPin);
+		}
+
+		// echoMicros: takes sensor reading and returns echo time in microseconds or NO_ECHO on timeout,
+		// timed on the game's time source (see clock.h) to not be dependant on CPU clock
+		uint32_t echoMicros(){
+			TRACE_SCOPE("Sensor::reading");
+			int status = HAL::Gpio::directionOutput(mTriggerPin, HAL::GPIO_HIGH);
+			Clock::sleepFor(std::chrono::microseconds(10));
+			status = status | HAL::Gpio::directionOutput(mTriggerPin, HAL::GPIO_LOW);
 			if(status < 0){
-				LOG::warning(std::string("failed to trigger ultrasonic sensor with trigger pin: ") + std::to_string(mTriggerPin) + " and echo pin: " + std::to_string(mEchoPin) + " with status: " + std::to_string(status));
+				LOG_WARNING(SENSOR_TRIGGER_FAILED, mTriggerPin, mEchoPin, status);
+				return NO_ECHO;
 			}
-			else{
-				auto inital = std::chrono::high_resolution_clock::now();
-				auto final = std::chrono::high_resolution_clock::now();
-				std::chrono::duration<double> elapsed;
-				while(gpio_get_value(mEchoPin) == 0){
-					final = std::chrono::high_resolution_clock::now();
-					elapsed = final - inital;
-					if(elapsed.count() > SENSOR_TIMEOUT){
-						return std::numeric_limits<double>::quiet_NaN();
-					}
+			int64_t initial = Clock::micros();
+			int64_t final = initial;
+			while(echoValue() == 0){
+				final = Clock::micros();
+				uint32_t waited = (uint32_t)(final - initial);
+				if(waited > SENSOR_TIMEOUT_MICROS){
+					LOG_DEBUG(SENSOR_TIMEOUT, mEchoPin, waited/1000000.0);
+					return NO_ECHO;
 				}
-				inital = std::chrono::system_clock::now();
-				while(gpio_get_value(mEchoPin) == 1){
-					final = std::chrono::high_resolution_clock::now();
-					elapsed = final - inital;
-					if(elapsed.count() > (2*MAX_DISTANCE)/SPEED_OF_SOUND){
-						break;
-					}
+			}
+			initial = Clock::micros();
+			uint32_t elapsed = 0;
+			while(echoValue() == 1){
+				final = Clock::micros();
+				elapsed = (uint32_t)(final - initial);
+				if(elapsed > MAX_ECHO_MICROS){
+					break;
 				}
-				return (SPEED_OF_SOUND*elapsed.count())/2;
 			}
-			return std::numeric_limits<double>::quiet_NaN();
+			return elapsed;
 		}
 
-		// readInterpolated: takes multiple readings and calls the interpolate function on the dataset
-		double readInterpolated(){
-			double distances[INTERPOLATION_SAMPLES];
+		// reading: takes sensor reading in metres, NaN on timeout
+		double reading(){
+			uint32_t echo = echoMicros();
+			if(echo == NO_ECHO){
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+			return echoToDistance(echo);
+		}
+
+		// settle: takes readings until STABLE_READINGS consecutive echoes lie within STABLE_ECHO_MICROS of each other,
+		// returns the number of readings taken or -1 if the sensor didn't settle within timeout
+		int settle(std::chrono::milliseconds timeout){
+			TRACE_SCOPE("Sensor::settle");
+			int64_t deadline = Clock::micros() + Clock::toMicros(timeout);
+			uint32_t lowest = 0;
+			uint32_t highest = 0;
+			int stable = 0;
+			int readings = 0;
+			while(Clock::micros() < deadline){
+				uint32_t echo = echoMicros();
+				readings++;
+				if(echo == NO_ECHO){
+					stable = 0;
+					continue;
+				}
+				if(echo > MAX_ECHO_MICROS){
+					echo = MAX_ECHO_MICROS;
+				}
+				if(stable == 0 || std::max(highest, echo) - std::min(lowest, echo) > STABLE_ECHO_MICROS){
+					lowest = echo;
+					highest = echo;
+					stable = 1;
+				}
+				else{
+					lowest = std::min(lowest, echo);
+					highest = std::max(highest, echo);
+					stable++;
+				}
+				if(stable >= STABLE_READINGS){
+					return readings;
+				}
+			}
+			return -1;
+		}
+
+		// readInterpolatedSample: takes multiple readings and returns the median echo time clamped to MAX_ECHO_MICROS
+		// with its capture time, echo time is 0 if most readings timed out
+		EchoSample readInterpolatedSample(){
+			TRACE_SCOPE("Sensor::readInterpolated");
+			uint32_t echoes[INTERPOLATION_SAMPLES];
+			EchoSample sample = {0, Metrics::nowMicros()};
 			int i = 0;
 			int numNANs = 0;
 			while(i < INTERPOLATION_SAMPLES){
 				if(numNANs > INTERPOLATION_SAMPLES/2){
-					return 0.0f;
+					Metrics::addSensorSamples(i + numNANs, numNANs);
+					return sample;
 				}
-				double read = reading();
-				if(read == read){
-					if(read > MAX_DISTANCE){
-						read = MAX_DISTANCE;
+				if(i == INTERPOLATION_SAMPLES/2){
+					sample.captured = Metrics::nowMicros();
+				}
+				uint32_t echo = echoMicros();
+				if(echo != NO_ECHO){
+					if(echo > MAX_ECHO_MICROS){
+						echo = MAX_ECHO_MICROS;
 					}
-					distances[i] = read;
+					echoes[i] = echo;
 					i++;
 				}
 				else{
 					numNANs++;
 				}
 			}
-			return interpolate(distances);
+			Metrics::addSensorSamples(i + numNANs, numNANs);
+			Stats::quicksort<uint32_t>(echoes, INTERPOLATION_SAMPLES);
+			sample.echo = echoes[INTERPOLATION_SAMPLES/2];
+			return sample;
+		}
+
+		// readInterpolatedMicros: median echo time of multiple readings in microseconds
+		uint32_t readInterpolatedMicros(){
+			return readInterpolatedSample().echo;
+		}
+
+		// readInterpolated: median distance of multiple readings in metres
+		double readInterpolated(){
+			return echoToDistance(readInterpolatedMicros());
+		}
+
+		// startWorker: starts the thread that takes threaded reads, MotionPong::init starts it so reading never creates
+		// a thread or allocates once the game is running
+		void startWorker(){
+			if(mWorker.joinable()){
+				return;
+			}
+			resetWorkerState();
+			mWorker = std::thread(&Sensor::workerLoop, this);
 		}
 
-		// launchThreadedRead: launches sensor read on thread promising future distance to mSensorValueFuture
+		// useSampler: takes threaded reads on pool's threads instead of a worker of this sensor, NULL returns to a worker
+		void useSampler(SamplerPool* pool){
+			stopWorker();
+			mSampler = pool;
+		}
+
+		// stopWorker: waits for a read in progress and stops the worker thread
+		void stopWorker(){
+			if(!mWorker.joinable()){
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mWorkerMutex);
+				mStopWorker = true;
+			}
+			mWorkerCondition.notify_all();
+			mWorker.join();
+		}
+
+		// launchThreadedRead: hands a sensor read to the sampler pool or the worker thread, starts the worker if it
+		// isn't running
 		void launchThreadedRead(){
-			mSensorValueFuture = std::async(&Sensor::readInterpolated, this);
+			if(mSampler == NULL){
+				startWorker();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mWorkerMutex);
+				mReadRequested = true;
+				mReadReady = false;
+			}
+			if(mSampler == NULL){
+				mWorkerCondition.notify_all();
+			}
+			else if(!mSampler->request(this)){
+				finishRead(false);
+			}
 		}
 
-		// joinThreadedRead: returns value from threaded function using the future
-		double joinThreadedRead(){
-			return mSensorValueFuture.get();
+		// takeRead: takes the launched read on the calling thread, called by the worker or a sampler pool thread
+		void takeRead(){
+			EchoSample sample = readInterpolatedSample();
+			{
+				std::lock_guard<std::mutex> lock(mWorkerMutex);
+				mWorkerSample = sample;
+			}
+			finishRead(true);
+		}
+
+		// finishRead: completes the launched read, joinThreadedRead returns NO_ECHO if there is no result
+		void finishRead(bool ready){
+			{
+				std::lock_guard<std::mutex> lock(mWorkerMutex);
+				mReadRequested = false;
+				mReadReady = ready;
+			}
+			mWorkerCondition.notify_all();
+		}
+
+		// joinThreadedRead: waits for and returns the sample of the last launched read, NO_ECHO if no read was launched
+		EchoSample joinThreadedRead(){
+			Metrics::ScopedPhase phase(Metrics::PHASE_SENSOR_WAIT);
+			TRACE_SCOPE("Sensor::joinThreadedRead");
+			std::unique_lock<std::mutex> lock(mWorkerMutex);
+			mWorkerCondition.wait(lock, [this](){ return !mReadRequested; });
+			if(!mReadReady){
+				EchoSample none = {NO_ECHO, Metrics::nowMicros()};
+				return none;
+			}
+			mReadReady = false;
+			return mWorkerSample;
 		}
 
 	private:
-		std::future<double> mSensorValueFuture;
+		// resetWorkerState: no read pending and worker allowed to run
+		void resetWorkerState(){
+			mReadRequested = false;
+			mReadReady = false;
+			mStopWorker = false;
+			mWorkerSample.echo = NO_ECHO;
+			mWorkerSample.captured = 0;
+		}
+
+		// workerLoop: takes one interpolated read per launchThreadedRead until stopWorker
+		void workerLoop(){
+			if(!Realtime::apply(Realtime::ROLE_SENSOR)){
+				LOG_WARNING(REALTIME_FAILED, (int)Realtime::ROLE_SENSOR, errno);
+			}
+			while(true){
+				{
+					std::unique_lock<std::mutex> lock(mWorkerMutex);
+					mWorkerCondition.wait(lock, [this](){ return mReadRequested || mStopWorker; });
+					if(mStopWorker){
+						mReadRequested = false;
+						mWorkerCondition.notify_all();
+						return;
+					}
+				}
+				takeRead();
+			}
+		}
+
+		std::thread mWorker;						// Thread taking threaded reads, see startWorker
+		std::mutex mWorkerMutex;					// Guards the read handshake below
+		std::condition_variable mWorkerCondition;	// Signals read requests, results and stop
+		bool mReadRequested;						// Read launched and not finished
+		bool mReadReady;							// mWorkerSample holds a result not yet joined
+		bool mStopWorker;							// Worker should exit
+		EchoSample mWorkerSample;					// Sample of the last finished read
+		SamplerPool* mSampler;						// Pool taking threaded reads, NULL if the sensor has its own worker
 		int mTriggerPin;
 		int mEchoPin;
+		const volatile uint32_t* mEchoRegister;		// Mapped data register of the echo pin, NULL to read through HAL::Gpio
+		uint32_t mEchoMask;							// Echo pin's bit in mEchoRegister
 	};
 	
+	void SamplerPool::stop(){
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mCondition.notify_all();
+		for(int i = 0; i < mThreadCount; i++){
+			mThreads[i].join();
+		}
+		mThreadCount = 0;
+		std::lock_guard<std::mutex> lock(mMutex);
+		while(mCount > 0){
+			mQueue[mHead]->finishRead(false);
+			mHead = (mHead + 1)%MAX_SAMPLER_REQUESTS;
+			mCount--;
+		}
+	}
+
+	void SamplerPool::loop(){
+		if(!Realtime::apply(Realtime::ROLE_SENSOR)){
+			LOG_WARNING(REALTIME_FAILED, (int)Realtime::ROLE_SENSOR, errno);
+		}
+		while(true){
+			Sensor* sensor;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this](){ return mCount > 0 || mStop; });
+				if(mStop){
+					return;
+				}
+				sensor = mQueue[mHead];
+				mHead = (mHead + 1)%MAX_SAMPLER_REQUESTS;
+				mCount--;
+			}
+			sensor->takeRead();
+		}
+	}
+
+	// Screen pixels per metre of hand movement
+	const Real SCREEN_X_SCALE = Real(OLED::SCREEN_WIDTH/(MAX_DISTANCE - MIN_DISTANCE));
+
 	// convertToScreenXCoord: converts distance in metres to OLED X coordinate
-	float convertToScreenXCoord(float distance){
-		if(distance < MIN_DISTANCE){
+	Real convertToScreenXCoord(Real distance){
+		if(distance < Real(MIN_DISTANCE)){
 			return 0;
 		}
-		return (distance - MIN_DISTANCE)*((float)OLED::SCREEN_WIDTH/(MAX_DISTANCE - MIN_DISTANCE));
+		return (distance - Real(MIN_DISTANCE))*SCREEN_X_SCALE;
 	}
+
+	// paddleColumn: truncates x to the column of a paddle of paddleWidth kept fully on screen
+	int paddleColumn(Real x, int paddleWidth){
+		if(x < 0){
+			return 0;
+		}
+		if(x >= OLED::SCREEN_WIDTH - paddleWidth){
+			return (OLED::SCREEN_WIDTH - paddleWidth) - 1;
+		}
+		return realToInt(x);
+	}
+
+	// class ColumnTable: paddle column of every quantized echo time, built once at startup from the
+	// float conversion (echoToDistance, convertToScreenXCoord then paddleColumn) so the per-frame path is a lookup,
+	// mirrored columns are for paddle 2 which faces player 1 across the table
+	class ColumnTable{
+	public:
+		ColumnTable(int paddleWidth){
+			for(int i = 0; i < ECHO_TABLE_SIZE; i++){
+				Real x = convertToScreenXCoord(echoToDistance(i*ECHO_QUANTUM));
+				mColumns[0][i] = (uint8_t)paddleColumn(x, paddleWidth);
+				mColumns[1][i] = (uint8_t)paddleColumn(OLED::SCREEN_WIDTH - x, paddleWidth);
+			}
+		}
+
+		// column: paddle column for echo time in microseconds, echo times past MAX_ECHO_MICROS use the last entry
+		int column(uint32_t micros, bool mirrored) const{
+			uint32_t index = micros/ECHO_QUANTUM;
+			if(index >= (uint32_t)ECHO_TABLE_SIZE){
+				index = ECHO_TABLE_SIZE - 1;
+			}
+			return mColumns[mirrored ? 1 : 0][index];
+		}
+
+	private:
+		uint8_t mColumns[2][ECHO_TABLE_SIZE];	// Columns for paddle 1 then mirrored for paddle 2
+	};
 }
 
 #endif // ULTRASONIC_H